@@ -0,0 +1,152 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <chrono>
+#include <filesystem>
+#include "batch_scanner.hpp"
+using namespace elf_parser;
+
+BatchScanner::BatchScanner(const scan_options_t &options)
+    : m_options{options}, m_pool{options.threads} {
+    if (m_options.max_in_flight == 0)
+        m_options.max_in_flight = 4 * m_pool.size();
+}
+
+scan_result_t BatchScanner::parse(const std::string &path) const {
+    scan_result_t result;
+    result.path = path;
+    try {
+        result.elf.reset(new Elf_parser(path));
+        if (m_options.decode_sections)
+            result.elf->get_sections();
+        if (m_options.decode_symbols)
+            result.elf->get_symbols();
+        if (m_options.decode_relocations)
+            result.elf->get_relocations();
+    } catch (const std::exception &e) {
+        result.elf.reset();
+        result.error = e.what();
+    }
+    return result;
+}
+
+scan_stats_t BatchScanner::run(const source_t &next_path, const sink_t &sink) {
+    auto start = std::chrono::steady_clock::now();
+    scan_stats_t stats;
+
+    std::mutex lock;
+    std::condition_variable ready_cv;
+    std::deque<scan_result_t> ready;
+    size_t in_flight = 0;
+    std::exception_ptr error;       // from the sink; later results are dropped
+
+    // hand one finished result to the sink, waiting for it if needed
+    auto drain_one = [&] {
+        std::unique_lock<std::mutex> guard(lock);
+        ready_cv.wait(guard, [&] { return !ready.empty(); });
+        scan_result_t result = std::move(ready.front());
+        ready.pop_front();
+        --in_flight;
+        guard.unlock();
+
+        if (error)
+            return;
+        if (result.elf)
+            ++stats.parsed;
+        else
+            ++stats.skipped;
+        try {
+            sink(result);
+        } catch (...) {
+            error = std::current_exception();
+        }
+    };
+
+    // the workers reference the locals above: every submitted file must be
+    // drained before this returns or throws
+    std::string path;
+    while (!error && next_path(path)) {
+        ++stats.files;
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (in_flight < m_options.max_in_flight) {
+                    ++in_flight;
+                    break;
+                }
+            }
+            drain_one();
+        }
+
+        m_pool.submit([this, path, &lock, &ready, &ready_cv] {
+            scan_result_t result = parse(path);
+            // notify under the lock: once the last result is taken, run()
+            // may return and destroy ready_cv
+            std::lock_guard<std::mutex> guard(lock);
+            ready.push_back(std::move(result));
+            ready_cv.notify_one();
+        });
+    }
+
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (in_flight == 0)
+                break;
+        }
+        drain_one();
+    }
+    if (error)
+        std::rethrow_exception(error);
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+scan_stats_t BatchScanner::scan(const std::vector<std::string> &paths, const sink_t &sink) {
+    size_t i = 0;
+    return run([&](std::string &path) {
+        if (i == paths.size())
+            return false;
+        path = paths[i++];
+        return true;
+    }, sink);
+}
+
+scan_stats_t BatchScanner::scan_directory(const std::string &root, const sink_t &sink) {
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+
+    return run([&](std::string &path) {
+        for (; !ec && (it != end); it.increment(ec)) {
+            std::error_code type_ec;
+            if (it->is_symlink(type_ec) || !it->is_regular_file(type_ec))
+                continue;
+            path = it->path().string();
+            it.increment(ec);
+            return true;
+        }
+        return false;
+    }, sink);
+}
@@ -0,0 +1,80 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_BATCH_SCANNER
+#define H_BATCH_SCANNER
+
+#include <functional>
+#include "elf_parser.hpp"
+#include "thread_pool.hpp"
+
+namespace elf_parser {
+
+typedef struct {
+    std::string path;
+    std::unique_ptr<Elf_parser> elf;    // null when the file was skipped
+    std::string error;                  // why the file was skipped
+} scan_result_t;
+
+typedef struct {
+    size_t threads = std::thread::hardware_concurrency();
+    size_t max_in_flight = 0;           // files parsed but not yet sunk; 0 = 4 x threads
+    bool decode_sections = true;        // warm these tables on the worker
+    bool decode_symbols = true;
+    bool decode_relocations = true;
+} scan_options_t;
+
+typedef struct {
+    size_t files = 0, parsed = 0, skipped = 0;
+    double seconds = 0;
+} scan_stats_t;
+
+/* Parses many files on a work-stealing pool and streams each result to a
+ * sink on the calling thread, in completion order. At most max_in_flight
+ * parsed files are held at once; the producer stops submitting until the
+ * sink has drained, which bounds memory. Files that are not ELF or
+ * cannot be read are reported with an error rather than aborting. An
+ * exception thrown by the sink stops the scan: files already submitted are
+ * parsed and dropped, then it is rethrown to the caller. */
+class BatchScanner {
+    public:
+        typedef std::function<void(scan_result_t &)> sink_t;
+
+        explicit BatchScanner(const scan_options_t &options = scan_options_t());
+
+        scan_stats_t scan(const std::vector<std::string> &paths, const sink_t &sink);
+
+        /* recursively walk a directory, scanning every regular file */
+        scan_stats_t scan_directory(const std::string &root, const sink_t &sink);
+
+    private:
+        typedef std::function<bool(std::string &)> source_t;
+
+        scan_stats_t run(const source_t &next_path, const sink_t &sink);
+        scan_result_t parse(const std::string &path) const;
+
+        scan_options_t m_options;
+        ThreadPool m_pool;
+};
+
+}
+#endif
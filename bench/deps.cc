@@ -0,0 +1,68 @@
+#include <iostream>
+#include <chrono>
+#include <dirent.h>
+#include "../dependency_graph.hpp"
+
+// dependency closure of every ELF executable in a directory: a fresh cache
+// per binary (what running ldd on each costs in parsing), one shared cache,
+// and the shared cache with the binaries spread over a pool.
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./deps [<directory>] [<threads>]\n";
+    std::string root = (argc > 1) ? argv[1] : "/usr/bin";
+    size_t threads = (argc > 2) ? strtoull(argv[2], nullptr, 0) : std::thread::hardware_concurrency();
+
+    std::vector<std::string> paths;
+    DIR *dir = opendir(root.c_str());
+    if (!dir) {
+        std::cerr << usage_banner;
+        return -1;
+    }
+    while (auto *ent = readdir(dir)) {
+        std::string path = root + "/" + ent->d_name;
+        try {
+            elf_parser::Elf_parser elf(path);
+            if (elf.get_dynamic_info().present)
+                paths.push_back(path);
+        } catch (const elf_parser::Elf_error &) {
+            // scripts, directories, static binaries
+        }
+    }
+    closedir(dir);
+
+    auto measure = [&](const char *name, auto &&run) {
+        auto start = std::chrono::steady_clock::now();
+        size_t nodes = run();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("%-8s %6zu binaries %10.1f ms %8.1f us/binary   (%zu nodes)\n",
+               name, paths.size(), ms, 1000 * ms / paths.size(), nodes);
+    };
+
+    measure("fresh", [&] {
+        size_t nodes = 0;
+        for (auto &path : paths) {
+            elf_parser::ObjectCache cache;
+            nodes += elf_parser::DependencyGraph(path, cache).nodes().size();
+        }
+        return nodes;
+    });
+
+    elf_parser::ObjectCache shared;
+    measure("shared", [&] {
+        size_t nodes = 0;
+        for (auto &path : paths)
+            nodes += elf_parser::DependencyGraph(path, shared).nodes().size();
+        return nodes;
+    });
+    printf("parsed %zu objects for %zu lookups\n", shared.parsed(), shared.lookups());
+
+    elf_parser::ObjectCache pooled;
+    elf_parser::ThreadPool pool(threads);
+    measure("pool", [&] {
+        std::atomic<size_t> nodes{0};
+        pool.parallel_for(paths.size(), [&](size_t i) {
+            nodes += elf_parser::DependencyGraph(paths[i], pooled, &pool).nodes().size();
+        });
+        return nodes.load();
+    });
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <iostream>
+#include <chrono>
+#include <unordered_map>
+#include "elf_gen.hpp"
+#include "../elf_diff.hpp"
+#include "../thread_pool.hpp"
+
+// what the diff looks like through get_symbols(): both tables materialized,
+// one side hashed by name, the other probed
+static size_t symbol_t_diff(const elf_parser::Elf_parser &old_elf, const elf_parser::Elf_parser &new_elf) {
+    auto &old_syms = old_elf.get_symbols(), &new_syms = new_elf.get_symbols();
+    std::unordered_map<std::string_view, const elf_parser::symbol_t*> by_name;
+    by_name.reserve(old_syms.size());
+    for (auto &sym : old_syms)
+        if (sym.symbol_section == ".symtab")
+            by_name.emplace(sym.symbol_name, &sym);
+    size_t changes = 0;
+    for (auto &sym : new_syms) {
+        if (sym.symbol_section != ".symtab")
+            continue;
+        auto it = by_name.find(sym.symbol_name);
+        if (it == by_name.end()) {
+            ++changes;
+            continue;
+        }
+        changes += it->second->symbol_size != sym.symbol_size;
+        by_name.erase(it);
+    }
+    return changes + by_name.size();
+}
+
+template <typename Fn>
+static double time_ms(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./diff [<symbols>] [<max threads>]\n";
+    if ((argc > 1) && (argv[1][0] == '-')) {
+        std::cerr << usage_banner;
+        return -1;
+    }
+
+    size_t nsyms = (argc > 1) ? strtoull(argv[1], nullptr, 0) : 2000000;
+    size_t max_threads = (argc > 2) ? strtoull(argv[2], nullptr, 0) : std::thread::hardware_concurrency();
+    size_t added = nsyms / 100;
+
+    // the new build has 1% more functions, two more data sections and a
+    // larger .text and LOAD segment
+    std::string old_path = "/tmp/elf_parser_diff_old.o", new_path = "/tmp/elf_parser_diff_new.o";
+    if (!elf_gen::write_elf(old_path, 4, nsyms, 0, nsyms / 10) ||
+        !elf_gen::write_elf(new_path, 6, nsyms + added, 0, nsyms / 10)) {
+        std::cerr << "cannot write " << old_path << "\n";
+        return -1;
+    }
+
+    bool ok = true;
+    {
+        elf_parser::Elf_parser old_elf(old_path), new_elf(new_path);
+        size_t changes = 0;
+        double ms = time_ms([&] { changes = symbol_t_diff(old_elf, new_elf); });
+        ok &= changes == added;
+        printf("%-24s %10zu symbol changes %10.1f ms\n", "get_symbols() + hash", changes, ms);
+    }
+
+    for (size_t threads = 0; ; threads = threads ? std::min(threads * 2, max_threads) : 1) {
+        elf_parser::Elf_parser old_elf(old_path), new_elf(new_path);
+        std::unique_ptr<elf_parser::ThreadPool> pool;
+        elf_parser::diff_options_t options;
+        if (threads) {
+            pool.reset(new elf_parser::ThreadPool(threads));
+            options.parallel_for = [&](size_t n, const std::function<void(size_t)> &fn) {
+                pool->parallel_for(n, fn);
+            };
+        }
+
+        size_t symbols = 0, sections = 0, segments = 0, dynamic = 0;
+        elf_parser::diff_summary_t summary;
+        double ms = time_ms([&] {
+            summary = elf_parser::diff(old_elf, new_elf, [&](const elf_parser::diff_entry_t &entry) {
+                switch (entry.scope) {
+                    case elf_parser::diff_scope_t::symbol: ++symbols; break;
+                    case elf_parser::diff_scope_t::section: ++sections; break;
+                    case elf_parser::diff_scope_t::segment: ++segments; break;
+                    case elf_parser::diff_scope_t::dynamic: ++dynamic; break;
+                }
+            }, options);
+        });
+        // .text, .symtab, .strtab and .shstrtab grow; .data.4 and .data.5 are new
+        ok &= symbols == added && segments == 1 && dynamic == 0 && sections == 6 &&
+              summary.symbol_bytes == (int64_t)(added * elf_gen::func_size);
+        std::string label = "diff(), " + (threads ? std::to_string(threads) + " threads" : std::string("serial"));
+        printf("%-24s %10zu symbol changes %10.1f ms\n", label.c_str(), symbols, ms);
+
+        if (threads >= max_threads)
+            break;
+    }
+
+    remove(old_path.c_str());
+    remove(new_path.c_str());
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
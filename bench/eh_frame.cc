@@ -0,0 +1,71 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include "../eh_frame.hpp"
+
+// PC to FDE lookups against a real library: .eh_frame_hdr searched in place
+// against the table built by scanning .eh_frame, one PC at a time and as a
+// sorted batch, the shape of a profiler's sample stream.
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./eh_frame [<elf-file>] [<pcs>]\n";
+    std::string path = (argc > 1) ? argv[1] : "/lib/x86_64-linux-gnu/libstdc++.so.6";
+    size_t npcs = (argc > 2) ? strtoull(argv[2], nullptr, 0) : 1000000;
+    if ((argc > 1) && (argv[1][0] == '-')) {
+        std::cerr << usage_banner;
+        return -1;
+    }
+
+    elf_parser::Elf_parser elf(path);
+    auto now = [] { return std::chrono::steady_clock::now(); };
+    auto ms_since = [&](auto start) {
+        return std::chrono::duration<double, std::milli>(now() - start).count();
+    };
+
+    auto start = now();
+    elf_parser::EhFrame hdr(elf);
+    double hdr_ms = ms_since(start);
+    start = now();
+    elf_parser::EhFrame scan(elf, false);
+    double scan_ms = ms_since(start);
+    printf("%zu FDEs; open %.3f ms with .eh_frame_hdr (%s), %.3f ms scanning .eh_frame\n",
+           scan.size(), hdr_ms, hdr.from_header() ? "found" : "missing", scan_ms);
+    if (scan.size() == 0)
+        return 0;
+
+    // samples cluster: pick a function, then a few PCs inside it
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> pcs;
+    while (pcs.size() < npcs) {
+        auto fde = scan.fde_at(scan.entry(rng() % scan.size()).second);
+        for (int i = 0; i < 8; ++i)
+            pcs.push_back(fde.pc_begin + rng() % (fde.pc_end - fde.pc_begin));
+    }
+    std::vector<uint64_t> sorted = pcs;
+    std::sort(sorted.begin(), sorted.end());
+
+    auto measure = [&](const char *name, auto &&run) {
+        auto start = now();
+        uint64_t sum = run();
+        double ms = ms_since(start);
+        printf("%-14s %8zu pcs %8.1f ms %7.1f ns/pc   (%lu)\n",
+               name, pcs.size(), ms, 1e6 * ms / pcs.size(), sum);
+    };
+    for (auto *table : {&hdr, &scan}) {
+        const char *one = (table == &hdr) ? "hdr single" : "scan single";
+        const char *batch = (table == &hdr) ? "hdr batch" : "scan batch";
+        measure(one, [&] {
+            uint64_t sum = 0;
+            for (auto pc : pcs)
+                sum += table->lookup(pc);
+            return sum;
+        });
+        measure(batch, [&] {
+            uint64_t sum = 0;
+            for (auto offset : table->lookup(sorted))
+                sum += offset;
+            return sum;
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,289 @@
+// Deterministic synthetic ELF64 objects for the benchmarks: N extra data
+// sections, M FUNC symbols in .symtab, K relocations in .rela.text and,
+// optionally, the first D symbols exported through .dynsym and .gnu.hash.
+// Function bodies are func_size bytes unless told otherwise. Optionally too:
+// REL entries in .rel.data, RELR-packed relative relocations in .relr.dyn,
+// and, with dynamic (which needs D > 0), a .dynamic section and a build-id
+// note.
+
+#ifndef H_ELF_GEN
+#define H_ELF_GEN
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <elf.h>
+
+namespace elf_gen {
+
+static const uint64_t text_addr = 0x1000;
+static const uint64_t func_size = 16;
+
+template <typename T>
+static size_t append(std::vector<uint8_t> &out, const T *data, size_t count) {
+    size_t offset = out.size();
+    out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)(data + count));
+    return offset;
+}
+
+static void align(std::vector<uint8_t> &out, size_t alignment) {
+    out.resize((out.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+static uint32_t add_string(std::vector<char> &strtab, const std::string &s) {
+    uint32_t offset = strtab.size();
+    strtab.insert(strtab.end(), s.begin(), s.end());
+    strtab.push_back('\0');
+    return offset;
+}
+
+static uint32_t gnu_hash(const std::string &name) {
+    uint32_t h = 5381;
+    for (unsigned char c : name)
+        h = (h << 5) + h + c;
+    return h;
+}
+
+/* writes the object to path and returns false when it cannot be written */
+inline bool write_elf(const std::string &path, size_t nsections, size_t nsyms, size_t nrelocs,
+                      size_t ndynsyms = 0, size_t body_size = func_size,
+                      size_t nrels = 0, size_t nrelrs = 0, bool dynamic = false) {
+    std::vector<uint8_t> out(sizeof(Elf64_Ehdr) + sizeof(Elf64_Phdr), 0);
+    std::vector<Elf64_Shdr> shdrs(1);           // [0] is SHT_NULL
+    std::vector<char> shstrtab(1, '\0');
+
+    auto add_section = [&](const std::string &name, uint32_t type, uint64_t flags,
+                           uint64_t addr, size_t offset, size_t size, size_t entsize) {
+        Elf64_Shdr shdr = {};
+        shdr.sh_name = add_string(shstrtab, name);
+        shdr.sh_type = type;
+        shdr.sh_flags = flags;
+        shdr.sh_addr = addr;
+        shdr.sh_offset = offset;
+        shdr.sh_size = size;
+        shdr.sh_entsize = entsize;
+        shdr.sh_addralign = 8;
+        shdrs.push_back(shdr);
+        return (uint32_t)shdrs.size() - 1;
+    };
+
+    // .text: one body per function, bodies repeat with period 64
+    align(out, 16);
+    size_t text_size = nsyms * body_size;
+    size_t text_off = out.size();
+    out.resize(text_off + text_size);
+    for (size_t i = 0; i < text_size; ++i)
+        out[text_off + i] = (uint8_t)(((i / body_size) % 64) * 3 + i % body_size);
+    uint32_t text_idx = add_section(".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+                                    text_addr, text_off, text_size, 0);
+
+    uint64_t data_addr = text_addr + ((text_size + 0xfff) & ~0xfffull);
+    for (size_t i = 0; i < nsections; ++i) {
+        uint64_t data[8];
+        for (int j = 0; j < 8; ++j)
+            data[j] = i * 8 + j;
+        size_t off = append(out, data, 8);
+        add_section(".data." + std::to_string(i), SHT_PROGBITS, SHF_ALLOC | SHF_WRITE,
+                    data_addr + i * sizeof(data), off, sizeof(data), 0);
+    }
+
+    std::vector<char> strtab(1, '\0');
+    std::vector<Elf64_Sym> syms(nsyms + 1);
+    memset(syms.data(), 0, sizeof(Elf64_Sym));
+    for (size_t i = 1; i <= nsyms; ++i) {
+        Elf64_Sym &sym = syms[i];
+        sym.st_name = add_string(strtab, "fn_" + std::to_string(i));
+        sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_FUNC);
+        sym.st_other = STV_DEFAULT;
+        sym.st_shndx = text_idx;
+        sym.st_value = text_addr + (i - 1) * body_size;
+        sym.st_size = body_size;
+    }
+
+    align(out, 8);
+    size_t symtab_off = append(out, syms.data(), syms.size());
+    size_t strtab_off = append(out, strtab.data(), strtab.size());
+    uint32_t symtab_idx = add_section(".symtab", SHT_SYMTAB, 0, 0, symtab_off,
+                                      syms.size() * sizeof(Elf64_Sym), sizeof(Elf64_Sym));
+    uint32_t strtab_idx = add_section(".strtab", SHT_STRTAB, 0, 0, strtab_off, strtab.size(), 0);
+    shdrs[symtab_idx].sh_link = strtab_idx;
+    shdrs[symtab_idx].sh_info = 1;
+
+    std::vector<Elf64_Rela> relas(nrelocs);
+    for (size_t k = 0; k < nrelocs; ++k) {
+        relas[k].r_offset = text_addr + (text_size ? (k * 8) % text_size : 0);
+        relas[k].r_info = ELF64_R_INFO(nsyms ? 1 + k % nsyms : 0, R_X86_64_PLT32);
+        relas[k].r_addend = -4;
+    }
+    align(out, 8);
+    size_t rela_off = append(out, relas.data(), relas.size());
+    uint32_t rela_idx = add_section(".rela.text", SHT_RELA, SHF_INFO_LINK, 0, rela_off,
+                                    relas.size() * sizeof(Elf64_Rela), sizeof(Elf64_Rela));
+    shdrs[rela_idx].sh_link = symtab_idx;
+    shdrs[rela_idx].sh_info = text_idx;
+
+    if (nrels) {
+        std::vector<Elf64_Rel> rels(nrels);
+        for (size_t k = 0; k < nrels; ++k) {
+            rels[k].r_offset = data_addr + (k * 8) % std::max<size_t>(nsections * 64, 8);
+            rels[k].r_info = ELF64_R_INFO(nsyms ? 1 + k % nsyms : 0, R_X86_64_64);
+        }
+        align(out, 8);
+        size_t rel_off = append(out, rels.data(), rels.size());
+        uint32_t rel_idx = add_section(".rel.data", SHT_REL, SHF_INFO_LINK, 0, rel_off,
+                                       rels.size() * sizeof(Elf64_Rel), sizeof(Elf64_Rel));
+        shdrs[rel_idx].sh_link = symtab_idx;
+        shdrs[rel_idx].sh_info = text_idx;
+    }
+
+    if (nrelrs) {
+        // runs of 630 words, ten full bitmaps each, then a gap and a new
+        // address entry, as linkers emit for tables of pointers
+        std::vector<uint64_t> relr;
+        uint64_t where = data_addr;
+        for (size_t left = nrelrs; left; ) {
+            relr.push_back(where);
+            --left;
+            uint64_t next = where + 8;
+            for (int b = 0; (b < 10) && left; ++b) {
+                size_t bits = std::min<size_t>(63, left);
+                relr.push_back((((1ull << bits) - 1) << 1) | 1);
+                left -= bits;
+                next += 63 * 8;
+            }
+            where = next + 64;
+        }
+        align(out, 8);
+        size_t relr_off = append(out, relr.data(), relr.size());
+        add_section(".relr.dyn", SHT_RELR, SHF_ALLOC, 0, relr_off, relr.size() * 8, 8);
+    }
+
+    ndynsyms = std::min(ndynsyms, nsyms);
+    if (ndynsyms) {
+        // .gnu.hash wants the exported symbols grouped by bucket
+        uint32_t nbuckets = ndynsyms / 4 + 1, bloom_size = 1, bloom_shift = 6;
+        while (bloom_size * 32 < ndynsyms)
+            bloom_size <<= 1;
+
+        std::vector<std::pair<uint32_t, size_t>> order;     // (hash, symtab index)
+        for (size_t i = 1; i <= ndynsyms; ++i)
+            order.push_back({gnu_hash("fn_" + std::to_string(i)), i});
+        std::stable_sort(order.begin(), order.end(), [&](const auto &a, const auto &b) {
+            return a.first % nbuckets < b.first % nbuckets;
+        });
+
+        std::vector<char> dynstr(1, '\0');
+        std::vector<Elf64_Sym> dynsyms(1);
+        memset(dynsyms.data(), 0, sizeof(Elf64_Sym));
+        std::vector<uint64_t> bloom(bloom_size, 0);
+        std::vector<uint32_t> buckets(nbuckets, 0), chain(order.size());
+
+        for (size_t j = 0; j < order.size(); ++j) {
+            uint32_t h = order[j].first;
+            Elf64_Sym sym = syms[order[j].second];
+            sym.st_name = add_string(dynstr, "fn_" + std::to_string(order[j].second));
+            dynsyms.push_back(sym);
+
+            bloom[(h / 64) % bloom_size] |= (1ull << (h % 64)) | (1ull << ((h >> bloom_shift) % 64));
+            if (!buckets[h % nbuckets])
+                buckets[h % nbuckets] = j + 1;
+            bool last = (j + 1 == order.size()) || (order[j + 1].first % nbuckets != h % nbuckets);
+            chain[j] = last ? (h | 1) : (h & ~1u);
+        }
+
+        std::vector<Elf64_Dyn> dyn;
+        if (dynamic) {
+            dyn.push_back({DT_NEEDED, {add_string(dynstr, "libc.so.6")}});
+            dyn.push_back({DT_NEEDED, {add_string(dynstr, "libm.so.6")}});
+            dyn.push_back({DT_SONAME, {add_string(dynstr, "libgen.so")}});
+            dyn.push_back({DT_RUNPATH, {add_string(dynstr, "$ORIGIN/lib")}});
+            dyn.push_back({DT_FLAGS_1, {DF_1_NOW}});
+            dyn.push_back({DT_NULL, {0}});
+        }
+
+        std::vector<uint8_t> hash;
+        uint32_t header[4] = {nbuckets, 1, bloom_size, bloom_shift};
+        append(hash, header, 4);
+        append(hash, bloom.data(), bloom.size());
+        append(hash, buckets.data(), buckets.size());
+        append(hash, chain.data(), chain.size());
+
+        align(out, 8);
+        size_t dynsym_off = append(out, dynsyms.data(), dynsyms.size());
+        size_t dynstr_off = append(out, dynstr.data(), dynstr.size());
+        align(out, 8);
+        size_t hash_off = append(out, hash.data(), hash.size());
+
+        uint32_t dynsym_idx = add_section(".dynsym", SHT_DYNSYM, SHF_ALLOC, 0, dynsym_off,
+                                          dynsyms.size() * sizeof(Elf64_Sym), sizeof(Elf64_Sym));
+        uint32_t dynstr_idx = add_section(".dynstr", SHT_STRTAB, SHF_ALLOC, 0, dynstr_off, dynstr.size(), 0);
+        uint32_t hash_idx = add_section(".gnu.hash", SHT_GNU_HASH, SHF_ALLOC, 0, hash_off, hash.size(), 0);
+        shdrs[dynsym_idx].sh_link = dynstr_idx;
+        shdrs[dynsym_idx].sh_info = 1;
+        shdrs[hash_idx].sh_link = dynsym_idx;
+
+        if (dynamic) {
+            align(out, 8);
+            size_t dyn_off = append(out, dyn.data(), dyn.size());
+            uint32_t dyn_idx = add_section(".dynamic", SHT_DYNAMIC, SHF_ALLOC | SHF_WRITE, 0, dyn_off,
+                                           dyn.size() * sizeof(Elf64_Dyn), sizeof(Elf64_Dyn));
+            shdrs[dyn_idx].sh_link = dynstr_idx;
+
+            // namesz, descsz, type, "GNU\0", then a 20-byte id
+            uint32_t note[3 + 1 + 5] = {4, 20, NT_GNU_BUILD_ID};
+            memcpy(&note[3], "GNU", 4);
+            for (int i = 0; i < 5; ++i)
+                note[4 + i] = gnu_hash(std::to_string(nsyms * 5 + i));
+            align(out, 4);
+            size_t note_off = append(out, note, 9);
+            uint32_t note_idx = add_section(".note.gnu.build-id", SHT_NOTE, SHF_ALLOC, 0, note_off,
+                                            sizeof(note), 0);
+            shdrs[note_idx].sh_addralign = 4;
+        }
+    }
+
+    uint32_t shstrtab_idx = add_section(".shstrtab", SHT_STRTAB, 0, 0, 0, 0, 0);
+    shdrs[shstrtab_idx].sh_offset = append(out, shstrtab.data(), shstrtab.size());
+    shdrs[shstrtab_idx].sh_size = shstrtab.size();
+
+    align(out, 8);
+    size_t shoff = append(out, shdrs.data(), shdrs.size());
+
+    Elf64_Ehdr ehdr = {};
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_type = ET_DYN;
+    ehdr.e_machine = EM_X86_64;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_phoff = sizeof(Elf64_Ehdr);
+    ehdr.e_shoff = shoff;
+    ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+    ehdr.e_phentsize = sizeof(Elf64_Phdr);
+    ehdr.e_phnum = 1;
+    ehdr.e_shentsize = sizeof(Elf64_Shdr);
+    ehdr.e_shnum = shdrs.size();
+    ehdr.e_shstrndx = shstrtab_idx;
+    memcpy(out.data(), &ehdr, sizeof(ehdr));
+
+    Elf64_Phdr phdr = {};
+    phdr.p_type = PT_LOAD;
+    phdr.p_flags = PF_R | PF_X;
+    phdr.p_offset = text_off;
+    phdr.p_vaddr = phdr.p_paddr = text_addr;
+    phdr.p_filesz = phdr.p_memsz = text_size;
+    phdr.p_align = 0x1000;
+    memcpy(out.data() + sizeof(Elf64_Ehdr), &phdr, sizeof(phdr));
+
+    FILE *f = fopen(path.c_str(), "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+    return (fclose(f) == 0) && ok;
+}
+
+}
+#endif
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <chrono>
+#include <filesystem>
+#include "../fingerprint.hpp"
+
+// build-id and notes for every regular file under a directory, warm page
+// cache: mapping each file with Elf_parser against fingerprint(), one file
+// at a time, on the thread pool and through io_uring.
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./fingerprint [<directory>] [<max files>] [<queue depth>]\n";
+    std::string root = (argc > 1) ? argv[1] : "/usr/lib";
+    size_t max_files = (argc > 2) ? strtoull(argv[2], nullptr, 0) : 100000;
+    size_t depth = (argc > 3) ? strtoull(argv[3], nullptr, 0) : 64;
+    if (root[0] == '-') {
+        std::cerr << usage_banner;
+        return -1;
+    }
+
+    namespace fs = std::filesystem;
+    std::vector<std::string> paths;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+            !ec && (it != end) && (paths.size() < max_files); it.increment(ec)) {
+        std::error_code type_ec;
+        if (!it->is_symlink(type_ec) && it->is_regular_file(type_ec))
+            paths.push_back(it->path().string());
+    }
+
+    auto measure = [&](const char *name, auto &&run) {
+        run();      // warm the page cache and dentries
+        auto start = std::chrono::steady_clock::now();
+        size_t ids = run();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%-9s %7zu files %8.1f ms %9.0f files/s   (%zu build-ids)\n",
+               name, paths.size(), 1000 * s, paths.size() / s, ids);
+    };
+
+    measure("parse", [&] {
+        size_t ids = 0;
+        for (auto &path : paths) {
+            try {
+                ids += !elf_parser::Elf_parser(path).get_build_id().empty();
+            } catch (const elf_parser::Elf_error &) {
+            }
+        }
+        return ids;
+    });
+    measure("pread", [&] {
+        size_t ids = 0;
+        for (auto &path : paths)
+            ids += !elf_parser::fingerprint(path).build_id.empty();
+        return ids;
+    });
+
+    auto batch = [&](elf_parser::Fingerprinter &fp) {
+        return [&] {
+            size_t ids = 0;
+            for (auto &f : fp.run(paths))
+                ids += !f.build_id.empty();
+            return ids;
+        };
+    };
+    elf_parser::Fingerprinter pool({std::thread::hardware_concurrency(), depth, false});
+    measure("pool", batch(pool));
+    elf_parser::Fingerprinter ring({std::thread::hardware_concurrency(), depth, true});
+    if (ring.uses_io_uring())
+        measure("io_uring", batch(ring));
+    else
+        printf("io_uring unavailable\n");
+    return 0;
+}
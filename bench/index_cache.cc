@@ -0,0 +1,81 @@
+#include <iostream>
+#include <chrono>
+#include <dirent.h>
+#include "elf_gen.hpp"
+#include "../elf_index.hpp"
+
+// cold: parse and build every index; warm: map the cached ones. Both run
+// with the files in the page cache, so this measures CPU, not the disk.
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./index_cache [<libraries>] [<symbols each>] | --dir <path>\n";
+    std::vector<std::string> paths;
+    std::string gen_dir = "/tmp/elf_parser_index_libs";
+
+    if ((argc > 2) && (std::string(argv[1]) == "--dir")) {
+        DIR *dir = opendir(argv[2]);
+        if (!dir) {
+            std::cerr << usage_banner;
+            return -1;
+        }
+        while (auto *ent = readdir(dir)) {
+            std::string name = ent->d_name;
+            if (name.find(".so") == std::string::npos)
+                continue;
+            std::string path = std::string(argv[2]) + "/" + name;
+            try {
+                elf_parser::Elf_parser elf(path);
+                paths.push_back(path);
+            } catch (const elf_parser::Elf_error &) {
+                // linker scripts, ELF32, ...
+            }
+        }
+        closedir(dir);
+    } else if ((argc > 1) && (argv[1][0] == '-')) {
+        std::cerr << usage_banner;
+        return -1;
+    } else {
+        size_t nlibs = (argc > 1) ? strtoull(argv[1], nullptr, 0) : 2000;
+        size_t nsyms = (argc > 2) ? strtoull(argv[2], nullptr, 0) : 2000;
+        mkdir(gen_dir.c_str(), 0755);
+        for (size_t i = 0; i < nlibs; ++i) {
+            std::string path = gen_dir + "/lib" + std::to_string(i) + ".so";
+            if (!elf_gen::write_elf(path, 8, nsyms + i % 64, 0, 64)) {
+                std::cerr << "cannot write " << path << "\n";
+                return -1;
+            }
+            paths.push_back(path);
+        }
+    }
+
+    std::string cache_dir = "/tmp/elf_parser_index_cache";
+    system(("rm -rf " + cache_dir).c_str());
+
+    auto measure = [&](const char *name, auto &&open) {
+        uint64_t sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (auto &path : paths)
+            sum += open(path);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("%-8s %8zu libs %10.1f ms %8.1f us/lib   (%lu)\n",
+               name, paths.size(), ms, 1000 * ms / paths.size(), sum);
+    };
+
+    // what a process pays today: parse every library into a resolver
+    measure("parse", [](const std::string &path) {
+        elf_parser::Elf_parser elf(path);
+        elf_parser::SymbolResolver resolver(elf);
+        return resolver.size();
+    });
+
+    elf_parser::IndexCache cache(cache_dir);
+    measure("cold", [&](const std::string &path) {
+        return cache.open(path).symbol_count();
+    });
+    measure("warm", [&](const std::string &path) {
+        return cache.open(path).symbol_count();
+    });
+    printf("hits %zu, builds %zu\n", cache.hits(), cache.builds());
+
+    system(("rm -rf " + cache_dir + " " + gen_dir).c_str());
+    return 0;
+}
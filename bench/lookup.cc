@@ -0,0 +1,50 @@
+#include <iostream>
+#include <chrono>
+#include "../elf_parser.hpp"
+
+template <typename F>
+static void measure(const char *label, size_t nlibs, F fn) {
+    auto start = std::chrono::steady_clock::now();
+    size_t found = fn();
+    auto stop = std::chrono::steady_clock::now();
+
+    double us = std::chrono::duration<double, std::micro>(stop - start).count();
+    printf("%-20s %6zu libraries %10.2f us/library (%zu exported)\n",
+           label, nlibs, us / nlibs, found);
+}
+
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./lookup <symbol> [<shared object>...]\n";
+    if(argc < 3) {
+        std::cerr << usage_banner;
+        return -1;
+    }
+
+    std::string name(argv[1]);
+    std::vector<std::string> paths(argv + 2, argv + argc);
+    std::vector<elf_parser::Elf_parser> libs;
+    for (auto &path : paths)
+        libs.emplace_back(path);
+
+    measure("find_dynamic_symbol", libs.size(), [&] {
+        size_t found = 0;
+        for (auto &lib : libs)
+            found += lib.find_dynamic_symbol(name).has_value();
+        return found;
+    });
+
+    measure("get_symbols scan", libs.size(), [&] {
+        size_t found = 0;
+        for (auto &lib : libs) {
+            for (auto &sym : lib.get_symbols()) {
+                if ((sym.symbol_section == ".dynsym") && (sym.symbol_index != "UND") &&
+                        (sym.symbol_name == name)) {
+                    ++found;
+                    break;
+                }
+            }
+        }
+        return found;
+    });
+    return 0;
+}
@@ -0,0 +1,158 @@
+// get_relocations() checked against `readelf -rW`, entry by entry, then
+// timed. With no arguments it checks its own binary, which carries both
+// .symtab and .dynsym, so a relocation resolved through the wrong table
+// shows up as a name or value mismatch.
+
+#include <iostream>
+#include <chrono>
+#include <map>
+#include <sstream>
+#include "../elf_parser.hpp"
+
+typedef struct {
+    uint64_t offset = 0, info = 0, value = 0;
+    int64_t addend = 0;
+    std::string type, name;
+} dumped_t;
+
+// RELA and REL sections as `readelf -rW` prints them; RELR is listed in
+// another layout and left out
+static bool readelf_dump(const std::string &path, std::map<std::string, std::vector<dumped_t>> &out) {
+    FILE *pipe = popen(("readelf -rW '" + path + "' 2>/dev/null").c_str(), "r");
+    if (!pipe)
+        return false;
+    char line[4096];
+    std::string section;
+    bool any = false;
+    while (fgets(line, sizeof(line), pipe)) {
+        any = true;
+        std::string text(line);
+        if (text.rfind("Relocation section '", 0) == 0) {
+            section = text.substr(20, text.find('\'', 20) - 20);
+            continue;
+        }
+        std::istringstream in(text);
+        std::string offset, info;
+        dumped_t entry;
+        // 16 hex digits per column for ELF64, 8 for ELF32
+        if (!(in >> offset >> info >> entry.type) || (section.rfind(".relr", 0) == 0))
+            continue;
+        if (((offset.size() != 16) && (offset.size() != 8)) || (info.size() != offset.size()) ||
+            (offset.find_first_not_of("0123456789abcdef") != std::string::npos))
+            continue;
+        entry.offset = strtoull(offset.c_str(), nullptr, 16);
+        entry.info = strtoull(info.c_str(), nullptr, 16);
+        // the parser widens ELF32 r_info to the ELF64 layout
+        if (info.size() == 8)
+            entry.info = ELF64_R_INFO(ELF32_R_SYM(entry.info), ELF32_R_TYPE(entry.info));
+
+        // "<addend>" without a symbol, else "<value> <name> +|- <addend>"
+        std::vector<std::string> rest;
+        for (std::string token; in >> token; )
+            rest.push_back(token);
+        if (rest.size() == 1) {
+            entry.addend = strtoll(rest[0].c_str(), nullptr, 16);
+        } else if (rest.size() == 4) {
+            entry.value = strtoull(rest[0].c_str(), nullptr, 16);
+            entry.name = rest[1].substr(0, rest[1].find('@'));     // drop the version
+            entry.addend = strtoll(rest[3].c_str(), nullptr, 16) * ((rest[2] == "-") ? -1 : 1);
+        } else if (rest.size() == 2) {
+            entry.value = strtoull(rest[0].c_str(), nullptr, 16);
+            entry.name = rest[1].substr(0, rest[1].find('@'));
+        }
+        out[section].push_back(entry);
+    }
+    return (pclose(pipe) == 0) && any;
+}
+
+// readelf names STT_SECTION symbols after their section
+static std::string expected_name(const elf_parser::Elf_parser &elf, const std::string &section,
+                                 const elf_parser::relocation_t &rel) {
+    auto relsec = elf.find_section(section);
+    auto secs = elf.sections();
+    uint32_t link = relsec->header->sh_link;
+    uint64_t sym_idx = ELF64_R_SYM((uint64_t)rel.relocation_info);
+    if ((link == 0) || (link >= secs.size()) || (sym_idx == 0))
+        return rel.relocation_symbol_name;
+    auto syms = elf.symbols(secs[link]);
+    if (sym_idx >= syms.size())
+        return rel.relocation_symbol_name;
+    auto sym = syms[sym_idx].sym;
+    if ((ELF64_ST_TYPE(sym->st_info) == STT_SECTION) && (sym->st_shndx < secs.size()))
+        return std::string(secs[sym->st_shndx].name);
+    return rel.relocation_symbol_name;
+}
+
+static bool check(const std::string &program) {
+    std::map<std::string, std::vector<dumped_t>> dumped;
+    // a run that compares nothing must not pass as a regression check
+    if (!readelf_dump(program, dumped)) {
+        printf("%s: readelf unavailable or failed, nothing checked\n", program.c_str());
+        return false;
+    }
+
+    elf_parser::Elf_parser elf_parser(program);
+    bool both = elf_parser.find_section(".symtab") && elf_parser.find_section(".dynsym");
+
+    auto start = std::chrono::steady_clock::now();
+    auto &relocations = elf_parser.get_relocations();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::map<std::string, size_t> seen;
+    size_t checked = 0, mismatches = 0;
+    for (auto &rel : relocations) {
+        auto it = dumped.find(rel.relocation_section_name);
+        if (it == dumped.end())
+            continue;       // RELR
+        size_t i = seen[rel.relocation_section_name]++;
+        if (i >= it->second.size()) {
+            ++mismatches;
+            continue;
+        }
+        auto &want = it->second[i];
+        bool rela = elf_parser.find_section(rel.relocation_section_name)->header->sh_type == SHT_RELA;
+        std::string name = expected_name(elf_parser, rel.relocation_section_name, rel);
+        bool same = (want.offset == (uint64_t)rel.relocation_offset) &&
+                    (want.info == (uint64_t)rel.relocation_info) &&
+                    (want.type == rel.relocation_type) &&
+                    (want.value == (uint64_t)rel.relocation_symbol_value) &&
+                    (want.name == name) &&
+                    (!rela || (want.addend == (int64_t)rel.relocation_addend));
+        if (!same && (mismatches++ < 5))
+            printf("  %s[%zu]: readelf %016lx %s %016lx %s%+ld, got %016lx %s %016lx %s%+ld\n",
+                   rel.relocation_section_name.c_str(), i, want.offset, want.type.c_str(), want.value,
+                   want.name.c_str(), want.addend, (uint64_t)rel.relocation_offset,
+                   rel.relocation_type.c_str(), (uint64_t)rel.relocation_symbol_value, name.c_str(),
+                   (int64_t)rel.relocation_addend);
+        ++checked;
+    }
+    for (auto &section : dumped) {
+        if (seen[section.first] != section.second.size())
+            ++mismatches;
+    }
+
+    printf("%s: %zu relocations%s, %zu checked against readelf, %zu mismatches, %.2f ms\n",
+           program.c_str(), relocations.size(), both ? " (.symtab and .dynsym)" : "",
+           checked, mismatches, ms);
+    return (mismatches == 0) && (checked > 0);
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> programs(argv + 1, argv + argc);
+    if (programs.empty()) {
+        // resolved here: in the readelf child /proc/self/exe is readelf
+        char self[4096];
+        ssize_t n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+        if (n <= 0) {
+            std::cerr << "cannot resolve /proc/self/exe\n";
+            return -1;
+        }
+        programs.push_back(std::string(self, n));
+    }
+
+    bool ok = true;
+    for (auto &program : programs)
+        ok &= check(program);
+    printf("%s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <inttypes.h> // PRIu64
+#include "../symbol_resolver.hpp"
+
+template <typename F>
+static void measure(const char *label, size_t nlookups, F fn) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t checksum = fn();
+    auto stop = std::chrono::steady_clock::now();
+
+    double secs = std::chrono::duration<double>(stop - start).count();
+    printf("%-10s %10zu lookups %12.0f lookups/sec (checksum %" PRIu64 ")\n",
+           label, nlookups, nlookups / secs, checksum);
+}
+
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./resolver [<executable>] [<lookups>]\n";
+    if(argc < 2) {
+        std::cerr << usage_banner;
+        return -1;
+    }
+
+    std::string program((std::string)argv[1]);
+    size_t nlookups = (argc > 2) ? strtoull(argv[2], nullptr, 0) : 10000000;
+    elf_parser::Elf_parser elf_parser(program);
+    elf_parser::SymbolResolver resolver(elf_parser);
+    if (resolver.size() == 0) {
+        std::cerr << "no FUNC/OBJECT symbols\n";
+        return -1;
+    }
+
+    // sample PCs uniformly over the executable sections
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    for (auto sec : elf_parser.sections())
+        if ((sec.header->sh_flags & SHF_EXECINSTR) && sec.header->sh_size)
+            ranges.push_back({sec.header->sh_addr, sec.header->sh_size});
+
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> pcs(nlookups);
+    for (auto &pc : pcs) {
+        auto &range = ranges[rng() % ranges.size()];
+        pc = range.first + rng() % range.second;
+    }
+
+    printf("%zu symbols\n", resolver.size());
+    measure("single", nlookups, [&] {
+        uint64_t sum = 0;
+        for (auto pc : pcs) {
+            auto res = resolver.resolve(pc);
+            sum += res.found ? res.offset : 0;
+        }
+        return sum;
+    });
+    measure("batch", nlookups, [&] {
+        uint64_t sum = 0;
+        for (auto &res : resolver.resolve(std::span<const uint64_t>(pcs)))
+            sum += res.found ? res.offset : 0;
+        return sum;
+    });
+    // a stack trace at a time: the batch is far smaller than the table
+    measure("batch/16", nlookups, [&] {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < pcs.size(); i += 16) {
+            std::span<const uint64_t> batch(pcs.data() + i, std::min<size_t>(16, pcs.size() - i));
+            for (auto &res : resolver.resolve(batch))
+                sum += res.found ? res.offset : 0;
+        }
+        return sum;
+    });
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <chrono>
+#include <fstream>
+#include "../section_cache.hpp"
+#include "../thread_pool.hpp"
+
+// first access (decompression) and repeated access to the SHF_COMPRESSED
+// sections of a file, one at a time and prefetched across a pool. Without
+// an argument, builds an object with zlib-compressed debug sections.
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./section_cache [<elf-file with compressed sections>]\n";
+    std::string path = "/tmp/elf_parser_compressed.o";
+    if ((argc > 1) && (argv[1][0] == '-')) {
+        std::cerr << usage_banner;
+        return -1;
+    } else if (argc > 1) {
+        path = argv[1];
+    } else {
+        std::ofstream src("/tmp/elf_parser_compressed.c");
+        for (int i = 0; i < 20000; ++i)
+            src << "struct s" << i << " { int a; long b" << i << "; char c[" << i % 50 + 1 << "]; };\n"
+                << "int f" << i << "(struct s" << i << " *p, int x) { return p->a + x * " << i << "; }\n";
+        src.close();
+        if (system(("gcc -g -c /tmp/elf_parser_compressed.c -o " + path +
+                    " && objcopy --compress-debug-sections=zlib " + path).c_str()) != 0) {
+            std::cerr << "cannot build " << path << "\n";
+            return -1;
+        }
+    }
+
+    elf_parser::Elf_parser elf(path);
+    std::vector<elf_parser::section_ref_t> compressed;
+    uint64_t stored = 0, expanded = 0;
+    for (auto sec : elf.sections())
+        if (auto chdr = elf.get_compression_header(sec)) {
+            compressed.push_back(sec);
+            stored += sec.header->sh_size;
+            expanded += chdr->ch_size;
+        }
+    printf("%zu compressed sections, %lu -> %lu bytes\n", compressed.size(), stored, expanded);
+    if (compressed.empty())
+        return 0;
+
+    auto measure = [&](const char *name, size_t rounds, auto &&run) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t sum = 0;
+        for (size_t i = 0; i < rounds; ++i)
+            sum += run();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("%-10s %10.3f ms/round %10.1f ns/section %8.1f MB/s   (%lu)\n", name, 1000 * s / rounds,
+               1e9 * s / (rounds * compressed.size()), rounds * expanded / s / 1e6, sum);
+    };
+
+    measure("cold", 20, [&] {
+        elf_parser::SectionCache cache(elf);
+        uint64_t sum = 0;
+        for (auto &sec : compressed)
+            sum += cache.get(sec).data.size();
+        return sum;
+    });
+
+    elf_parser::SectionCache warm(elf);
+    warm.prefetch(compressed);
+    measure("warm", 100000, [&] {
+        uint64_t sum = 0;
+        for (auto &sec : compressed)
+            sum += warm.get(sec).data.size();
+        return sum;
+    });
+
+    elf_parser::ThreadPool pool;
+    measure("prefetch", 20, [&] {
+        elf_parser::SectionCache cache(elf, 256 << 20,
+            [&](size_t n, const std::function<void(size_t)> &fn) { pool.parallel_for(n, fn); });
+        cache.prefetch(compressed);
+        return cache.stats().bytes_cached;
+    });
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <chrono>
+#include "elf_gen.hpp"
+#include "../size_attribution.hpp"
+#include "../thread_pool.hpp"
+
+template <typename Fn>
+static double time_ms(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const elf_parser::SizeAttribution &sizes) {
+    for (auto &sec : sizes.sections())
+        if (sec.symbols)
+            printf("  %-24.*s %12lu bytes %10lu symbols %12lu attributed %12lu identical\n",
+                   (int)sec.name.size(), sec.name.data(), sec.size, sec.symbols, sec.attributed, sec.identical);
+    size_t shown = 0;
+    for (auto &group : sizes.identical()) {
+        if (shown++ == 5)
+            break;
+        auto &first = sizes.symbols()[group.symbols[0]];
+        printf("  %zu x %lu bytes like %.*s\n", group.symbols.size(), group.size,
+               (int)first.name.size(), first.name.data());
+    }
+}
+
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./size_attribution [-j <threads>] [<file>...]\n";
+    size_t max_threads = std::thread::hardware_concurrency();
+    std::vector<std::string> programs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if ((arg == "-j") && (i + 1 < argc))
+            max_threads = strtoul(argv[++i], nullptr, 0);
+        else if (arg[0] == '-') {
+            std::cerr << usage_banner;
+            return -1;
+        } else
+            programs.push_back(arg);
+    }
+
+    // 1M functions of 1 KB: 1 GB of .text holding 64 distinct bodies
+    bool generated = programs.empty();
+    size_t nsyms = 1 << 20, body_size = 1024;
+    if (generated) {
+        programs.push_back("/tmp/elf_parser_size_attribution.o");
+        if (!elf_gen::write_elf(programs[0], 4, nsyms, 0, 0, body_size)) {
+            std::cerr << "cannot write " << programs[0] << "\n";
+            return -1;
+        }
+    }
+
+    bool ok = true;
+    for (auto &program : programs) {
+        elf_parser::Elf_parser elf_parser(program);
+        printf("%s\n", program.c_str());
+        printf("%-8s %12s %10s %8s\n", "Threads", "ms", "GB/s", "Groups");
+        for (size_t threads = 0; ; threads = threads ? std::min(threads * 2, max_threads) : 1) {
+            std::unique_ptr<elf_parser::ThreadPool> pool;
+            elf_parser::attribution_options_t options;
+            if (threads) {
+                pool.reset(new elf_parser::ThreadPool(threads));
+                options.parallel_for = [&](size_t n, const std::function<void(size_t)> &fn) {
+                    pool->parallel_for(n, fn);
+                };
+            }
+
+            std::unique_ptr<elf_parser::SizeAttribution> sizes;
+            double ms = time_ms([&] { sizes.reset(new elf_parser::SizeAttribution(elf_parser, options)); });
+            printf("%-8s %12.1f %10.2f %8zu\n", threads ? std::to_string(threads).c_str() : "serial",
+                   ms, sizes->hashed_bytes() / ms / 1e6, sizes->identical().size());
+
+            if (generated) {
+                auto text = elf_parser.find_section(".text");
+                auto &sec = sizes->sections()[text->index];
+                ok &= sizes->identical().size() == 64 && sec.attributed == sec.size &&
+                      sec.identical == sec.size - 64 * body_size;
+            }
+            if (threads >= max_threads) {
+                report(*sizes);
+                break;
+            }
+        }
+
+        // the hash alone over the whole .text
+        std::shared_ptr<const void> keep;
+        if (auto text = elf_parser.find_section(".text")) {
+            auto data = elf_parser.section_data(*text, keep);
+            uint64_t hash = 0;
+            double ms = time_ms([&] { hash = elf_parser::xxh64(data.data(), data.size()); });
+            printf("  xxh64 over .text: %.2f GB/s (%016lx)\n", data.size() / ms / 1e6, hash);
+        }
+    }
+
+    if (generated) {
+        remove(programs[0].c_str());
+        printf("%s\n", ok ? "ok" : "FAILED");
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <functional>
+#include "../elf_parser.hpp"
+
+// resident bytes of the mapping starting at addr, i.e. what the process
+// actually faulted in
+static uint64_t mapping_rss(const void *addr) {
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool in_map = false;
+    while (std::getline(smaps, line)) {
+        if (line.find('-') != std::string::npos && isxdigit(line[0])) {
+            in_map = (strtoull(line.c_str(), nullptr, 16) == (uintptr_t)addr);
+            continue;
+        }
+        if (in_map && line.compare(0, 4, "Rss:") == 0)
+            return strtoull(line.c_str() + 4, nullptr, 10) * 1024;
+    }
+    return 0;
+}
+
+static void measure(const std::string &program, const char *label,
+                    const std::function<size_t(elf_parser::Elf_parser &)> &op) {
+    for (bool stream : {false, true}) {
+        elf_parser::map_options_t options;
+        options.stream = stream;
+        options.advice = MADV_RANDOM;   // no readahead, so Rss counts touched pages
+
+        auto start = std::chrono::steady_clock::now();
+        elf_parser::Elf_parser elf_parser(program, options);
+        size_t n = op(elf_parser);
+        auto stop = std::chrono::steady_clock::now();
+
+        uint64_t bytes = stream ? elf_parser.get_bytes_read() : mapping_rss(elf_parser.get_memory_map());
+        double us = std::chrono::duration<double, std::micro>(stop - start).count();
+        printf("%-14s %-6s %10.1f us %12lu bytes (%5.1f%% of file) %8zu entries\n",
+               label, stream ? "pread" : "mmap", us, bytes,
+               100.0 * bytes / elf_parser.get_memory_size(), n);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./stream [<executable>]\n";
+    if(argc < 2) {
+        std::cerr << usage_banner;
+        return -1;
+    }
+
+    std::string program((std::string)argv[1]);
+    measure(program, "get_segments", [](elf_parser::Elf_parser &elf) {
+        return elf.get_segments().size();
+    });
+    measure(program, "get_symbols", [](elf_parser::Elf_parser &elf) {
+        return elf.get_symbols().size();
+    });
+    return 0;
+}
@@ -0,0 +1,261 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <new>
+#include <sys/resource.h>
+#include "elf_gen.hpp"
+#include "../elf_parser.hpp"
+
+// counts every heap allocation made by the process
+static uint64_t g_allocs = 0;
+
+static void *counted_alloc(size_t size, size_t align = 0) {
+    ++g_allocs;
+    // aligned_alloc() wants a multiple of the alignment
+    void *p = align ? aligned_alloc(align, (size + align - 1) & ~(align - 1)) : malloc(size);
+    if (p)
+        return p;
+    throw std::bad_alloc();
+}
+
+// the array and aligned forms too, so every new pairs with a delete from here
+void *operator new(size_t size) { return counted_alloc(size); }
+void *operator new[](size_t size) { return counted_alloc(size); }
+void *operator new(size_t size, std::align_val_t align) { return counted_alloc(size, (size_t)align); }
+void *operator new[](size_t size, std::align_val_t align) { return counted_alloc(size, (size_t)align); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { free(p); }
+
+typedef struct {
+    std::string name;
+    double ns_per_op = 0, allocs_per_op = 0;
+    long peak_rss_kb = 0;
+} result_t;
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/* Runs setup (untimed) then op (timed) until 0.2s of op time or 1000
+ * iterations have been spent, whichever comes first. */
+template <typename State>
+static result_t run(const std::string &name, const std::function<State()> &setup,
+                    const std::function<void(State &)> &op) {
+    using clock = std::chrono::steady_clock;
+    clock::duration spent{};
+    uint64_t allocs = 0, iterations = 0;
+
+    while ((iterations < 3) || ((spent < std::chrono::milliseconds(200)) && (iterations < 1000))) {
+        State state = setup();
+        uint64_t before = g_allocs;
+        auto start = clock::now();
+        op(state);
+        spent += clock::now() - start;
+        allocs += g_allocs - before;
+        ++iterations;
+    }
+
+    result_t result;
+    result.name = name;
+    result.ns_per_op = std::chrono::duration<double, std::nano>(spent).count() / iterations;
+    result.allocs_per_op = (double)allocs / iterations;
+    result.peak_rss_kb = peak_rss_kb();
+    return result;
+}
+
+static std::map<std::string, result_t> load_baseline(const std::string &path) {
+    std::map<std::string, result_t> baseline;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        char name[128];
+        result_t r;
+        if (sscanf(line.c_str(), "{\"name\": \"%127[^\"]\", \"ns_per_op\": %lf, \"allocs_per_op\": %lf, \"peak_rss_kb\": %ld}",
+                   name, &r.ns_per_op, &r.allocs_per_op, &r.peak_rss_kb) == 4) {
+            r.name = name;
+            baseline[r.name] = r;
+        }
+    }
+    return baseline;
+}
+
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./suite [--file <elf>] [--sections N] [--symbols M] [--relocs K] [--dynsyms D]\n"
+                          "               [--rels R] [--relrs P]\n"
+                          "               [--save <baseline.jsonl>] [--compare <baseline.jsonl>]\n";
+    std::string program, save_path, compare_path;
+    size_t nsections = 64, nsyms = 200000, nrelocs = 100000, ndynsyms = 50000;
+    size_t nrels = 20000, nrelrs = 100000;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (i + 1 >= argc) {
+            std::cerr << usage_banner;
+            return -1;
+        }
+        std::string value(argv[++i]);
+        if (arg == "--file") program = value;
+        else if (arg == "--sections") nsections = strtoull(value.c_str(), nullptr, 0);
+        else if (arg == "--symbols") nsyms = strtoull(value.c_str(), nullptr, 0);
+        else if (arg == "--relocs") nrelocs = strtoull(value.c_str(), nullptr, 0);
+        else if (arg == "--dynsyms") ndynsyms = strtoull(value.c_str(), nullptr, 0);
+        else if (arg == "--rels") nrels = strtoull(value.c_str(), nullptr, 0);
+        else if (arg == "--relrs") nrelrs = strtoull(value.c_str(), nullptr, 0);
+        else if (arg == "--save") save_path = value;
+        else if (arg == "--compare") compare_path = value;
+        else {
+            std::cerr << usage_banner;
+            return -1;
+        }
+    }
+
+    bool generated = program.empty();
+    if (generated) {
+        program = "/tmp/elf_parser_suite.o";
+        if (!elf_gen::write_elf(program, nsections, nsyms, nrelocs, ndynsyms, elf_gen::func_size,
+                                nrels, nrelrs, true)) {
+            std::cerr << "cannot write " << program << "\n";
+            return -1;
+        }
+    }
+
+    typedef std::unique_ptr<elf_parser::Elf_parser> parser_ptr;
+    auto fresh = [&] { return parser_ptr(new elf_parser::Elf_parser(program)); };
+    auto warm = parser_ptr(new elf_parser::Elf_parser(program));
+    auto shared = [&] { return warm.get(); };
+    std::string probe = "fn_" + std::to_string(std::max<size_t>(ndynsyms / 2, 1));
+
+    std::vector<result_t> results;
+    results.push_back(run<parser_ptr>("open_mmap", [] { return nullptr; },
+        [&](parser_ptr &p) { p = fresh(); }));
+    results.push_back(run<parser_ptr>("open_stream", [] { return nullptr; },
+        [&](parser_ptr &p) {
+            elf_parser::map_options_t options;
+            options.stream = true;
+            p.reset(new elf_parser::Elf_parser(program, options));
+        }));
+    results.push_back(run<parser_ptr>("get_sections", fresh, [](parser_ptr &p) { p->get_sections(); }));
+    results.push_back(run<parser_ptr>("get_segments", fresh, [](parser_ptr &p) { p->get_segments(); }));
+    results.push_back(run<parser_ptr>("get_symbols", fresh, [](parser_ptr &p) { p->get_symbols(); }));
+    results.push_back(run<parser_ptr>("get_relocations", fresh, [](parser_ptr &p) { p->get_relocations(); }));
+    warm->get_symbols();
+    results.push_back(run<elf_parser::Elf_parser*>("get_symbols_cached", shared,
+        [](elf_parser::Elf_parser *p) { p->get_symbols(); }));
+    results.push_back(run<elf_parser::Elf_parser*>("view_sections", shared,
+        [](elf_parser::Elf_parser *p) {
+            size_t n = 0;
+            for (auto sec : p->sections())
+                n += sec.name.size();
+            asm volatile("" :: "r"(n));
+        }));
+    results.push_back(run<elf_parser::Elf_parser*>("view_symbols", shared,
+        [](elf_parser::Elf_parser *p) {
+            size_t n = 0;
+            for (auto &sec : p->find_sections(SHT_SYMTAB))
+                for (auto sym : p->symbols(sec))
+                    n += sym.name.size();
+            asm volatile("" :: "r"(n));
+        }));
+    results.push_back(run<elf_parser::Elf_parser*>("view_relocations", shared,
+        [](elf_parser::Elf_parser *p) {
+            size_t n = 0;
+            for (auto &sec : p->find_sections(SHT_RELA))
+                for (auto rela : p->relocations(sec))
+                    n += rela.rela->r_info;
+            asm volatile("" :: "r"(n));
+        }));
+    results.push_back(run<elf_parser::Elf_parser*>("view_rel_relocations", shared,
+        [](elf_parser::Elf_parser *p) {
+            size_t n = 0;
+            for (auto &sec : p->find_sections(SHT_REL))
+                for (auto rel : p->rel_relocations(sec))
+                    n += rel.rel->r_info;
+            asm volatile("" :: "r"(n));
+        }));
+    results.push_back(run<elf_parser::Elf_parser*>("relr_count", shared,
+        [](elf_parser::Elf_parser *p) {
+            size_t n = 0;
+            for (auto &sec : p->find_sections(SHT_RELR))
+                n += p->relr_count(sec);
+            asm volatile("" :: "r"(n));
+        }));
+    // the output buffer is sized outside the timed part
+    typedef std::vector<uint64_t> relr_out_t;
+    results.push_back(run<relr_out_t>("decode_relr",
+        [&] {
+            size_t n = 0;
+            for (auto &sec : warm->find_sections(SHT_RELR))
+                n = std::max(n, warm->relr_count(sec));
+            return relr_out_t(n);
+        },
+        [&](relr_out_t &out) {
+            size_t n = 0;
+            for (auto &sec : warm->find_sections(SHT_RELR))
+                n += warm->decode_relr(sec, out.data(), out.size());
+            asm volatile("" :: "r"(n));
+        }));
+    results.push_back(run<elf_parser::Elf_parser*>("section_data", shared,
+        [](elf_parser::Elf_parser *p) {
+            size_t n = 0;
+            for (auto sec : p->sections()) {
+                std::shared_ptr<const void> keep;
+                n += p->section_data(sec, keep).size();
+            }
+            asm volatile("" :: "r"(n));
+        }));
+    results.push_back(run<parser_ptr>("get_dynamic_info", fresh,
+        [](parser_ptr &p) { p->get_dynamic_info(); }));
+    results.push_back(run<elf_parser::Elf_parser*>("get_build_id", shared,
+        [](elf_parser::Elf_parser *p) {
+            std::string id = p->get_build_id();
+            asm volatile("" :: "r"(id.size()));
+        }));
+    results.push_back(run<elf_parser::Elf_parser*>("find_section", shared,
+        [](elf_parser::Elf_parser *p) { p->find_section(".symtab"); }));
+    results.push_back(run<elf_parser::Elf_parser*>("find_dynamic_symbol_hit", shared,
+        [&](elf_parser::Elf_parser *p) { p->find_dynamic_symbol(probe); }));
+    results.push_back(run<elf_parser::Elf_parser*>("find_dynamic_symbol_miss", shared,
+        [](elf_parser::Elf_parser *p) { p->find_dynamic_symbol("not_exported"); }));
+
+    std::map<std::string, result_t> baseline;
+    if (!compare_path.empty())
+        baseline = load_baseline(compare_path);
+
+    printf("%s\n", program.c_str());
+    printf("%-26s %14s %12s %12s %10s\n", "Benchmark", "ns/op", "allocs/op", "peak RSS KB", "vs base");
+    for (auto &r : results) {
+        char delta[32] = "";
+        auto it = baseline.find(r.name);
+        if (it != baseline.end() && it->second.ns_per_op > 0)
+            snprintf(delta, sizeof(delta), "%+.1f%%", 100.0 * (r.ns_per_op / it->second.ns_per_op - 1));
+        printf("%-26s %14.1f %12.1f %12ld %10s\n", r.name.c_str(), r.ns_per_op, r.allocs_per_op,
+               r.peak_rss_kb, delta);
+    }
+
+    // one JSON object per line, so baselines diff cleanly between commits
+    if (!save_path.empty()) {
+        FILE *out = fopen(save_path.c_str(), "w");
+        if (!out) {
+            std::cerr << "cannot write " << save_path << "\n";
+            return -1;
+        }
+        for (auto &r : results)
+            fprintf(out, "{\"name\": \"%s\", \"ns_per_op\": %.1f, \"allocs_per_op\": %.1f, \"peak_rss_kb\": %ld}\n",
+                    r.name.c_str(), r.ns_per_op, r.allocs_per_op, r.peak_rss_kb);
+        fclose(out);
+    }
+
+    if (generated)
+        remove(program.c_str());
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <iostream>
+#include <chrono>
+#include <inttypes.h> // PRIu64
+#include "elf_gen.hpp"
+#include "../symbol_table.hpp"
+
+// heap and inline bytes of one materialized symbol_t
+static size_t symbol_t_bytes(const elf_parser::symbol_t &sym) {
+    size_t bytes = sizeof(elf_parser::symbol_t);
+    for (auto *s : {&sym.symbol_index, &sym.symbol_type, &sym.symbol_bind,
+                    &sym.symbol_visibility, &sym.symbol_name, &sym.symbol_section})
+        if (s->capacity() > 15)     // beyond the libstdc++ small-string buffer
+            bytes += s->capacity() + 1;
+    return bytes;
+}
+
+static void report(const std::string &program) {
+    elf_parser::Elf_parser elf_parser(program);
+
+    auto start = std::chrono::steady_clock::now();
+    elf_parser::SymbolTable table(elf_parser);
+    double table_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    auto &syms = elf_parser.get_symbols();
+    double vector_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    size_t vector_bytes = syms.capacity() * sizeof(elf_parser::symbol_t) - syms.size() * sizeof(elf_parser::symbol_t);
+    for (auto &sym : syms)
+        vector_bytes += symbol_t_bytes(sym);
+
+    start = std::chrono::steady_clock::now();
+    auto rows = table.select(elf_parser::symbol_type_t::func, elf_parser::symbol_bind_t::global);
+    double select_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    size_t n = table.size() ? table.size() : 1;
+    printf("%s: %zu symbols\n", program.c_str(), table.size());
+    printf("  %-12s %8.1f bytes/symbol %10.1f ms build\n", "symbol_t", (double)vector_bytes / n, vector_ms);
+    printf("  %-12s %8.1f bytes/symbol %10.1f ms build\n", "SymbolTable", (double)table.memory_usage() / n, table_ms);
+    printf("  GLOBAL FUNC: %zu rows selected in %.1f us\n", rows.size(), select_us);
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> programs(argv + 1, argv + argc);
+    bool generated = programs.empty();
+    if (generated) {
+        programs.push_back("/tmp/elf_parser_symbol_table.o");
+        if (!elf_gen::write_elf(programs[0], 4, 1000000, 0)) {
+            std::cerr << "cannot write " << programs[0] << "\n";
+            return -1;
+        }
+    }
+    for (auto &program : programs)
+        report(program);
+    if (generated)
+        remove(programs[0].c_str());
+    return 0;
+}
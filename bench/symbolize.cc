@@ -0,0 +1,122 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <dlfcn.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "../process_symbolizer.hpp"
+
+// Symbolizes this process against itself: its own functions, libc PCs
+// checked against dladdr(), and an incremental rescan after dlopen(). Then
+// times scans and batched resolution over forked copies of itself.
+extern "C" __attribute__((noinline)) int symbolize_probe(int x) {
+    return x * 3 + 1;
+}
+
+static double elapsed_us(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t nchildren = (argc > 1) ? strtoull(argv[1], nullptr, 0) : 8;
+    size_t threads = (argc > 2) ? strtoull(argv[2], nullptr, 0) : std::thread::hardware_concurrency();
+    pid_t self = getpid();
+    int failures = 0;
+
+    elf_parser::ParserCache cache;
+    elf_parser::ThreadPool pool(threads);
+    elf_parser::ProcessSymbolizer symbolizer(cache, &pool);
+
+    auto start = std::chrono::steady_clock::now();
+    symbolizer.scan(self);
+    printf("cold scan        %8.1f us  (%zu mappings, %zu files parsed)\n",
+           elapsed_us(start), symbolizer.added(), cache.parsed());
+
+    // own code, through the executable's load bias
+    uint64_t probe = (uint64_t)&symbolize_probe + 2;
+    auto own = symbolizer.resolve(self, std::span<const uint64_t>(&probe, 1));
+    auto &frame = own.frames[0];
+    printf("%#lx -> %s+%lu (vaddr %#lx in %s)\n", probe, std::string(frame.symbol.symbol_name).c_str(),
+           frame.symbol.offset, frame.vaddr, frame.object ? frame.object->path.c_str() : "?");
+    failures += (frame.symbol.symbol_name != "symbolize_probe") || (frame.symbol.offset != 2);
+
+    // libc: every symbol start must match what the dynamic loader reports
+    Dl_info info;
+    dladdr((void*)&printf, &info);
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> pcs;
+    for (size_t i = 0; i < 4096; ++i)
+        pcs.push_back((uint64_t)info.dli_fbase + rng() % (2 << 20));
+    auto libc = symbolizer.resolve(self, pcs);
+    size_t checked = 0, mismatched = 0;
+    for (size_t i = 0; i < pcs.size(); ++i) {
+        auto &f = libc.frames[i];
+        if (!f.symbol.found || !dladdr((void*)pcs[i], &info) || !info.dli_saddr)
+            continue;
+        // libc has no .symtab, so both see the same .dynsym starts
+        mismatched += pcs[i] - f.symbol.offset != (uint64_t)info.dli_saddr;
+        ++checked;
+    }
+    printf("libc: %zu pcs checked against dladdr, %zu mismatched\n", checked, mismatched);
+    failures += mismatched != 0;
+
+    // dlopen maps a new library: the rescan keeps every old mapping. The
+    // cache's own mappings of the files it parsed show up as added too.
+    size_t reused = symbolizer.reused(), added = symbolizer.added(), parsed = cache.parsed();
+    void *lib = dlopen("libz.so.1", RTLD_NOW);
+    start = std::chrono::steady_clock::now();
+    symbolizer.scan(self);
+    printf("rescan after dlopen %5.1f us  (%zu mappings kept, %zu added, %zu files parsed)\n",
+           elapsed_us(start), symbolizer.reused() - reused, symbolizer.added() - added,
+           cache.parsed() - parsed);
+    if (lib) {
+        uint64_t inflate = (uint64_t)dlsym(lib, "inflate");
+        auto z = symbolizer.resolve(self, std::span<const uint64_t>(&inflate, 1));
+        printf("%#lx -> %s\n", inflate, std::string(z.frames[0].symbol.symbol_name).c_str());
+        failures += z.frames[0].symbol.symbol_name != "inflate";
+    }
+    start = std::chrono::steady_clock::now();
+    symbolizer.scan(self);
+    printf("unchanged rescan %8.1f us\n", elapsed_us(start));
+
+    // forked copies share the layout, so the same pcs resolve in each
+    std::vector<pid_t> pids;
+    for (size_t i = 0; i < nchildren; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            pause();
+            _exit(0);
+        }
+        pids.push_back(pid);
+    }
+    elf_parser::ParserCache fresh;
+    elf_parser::ProcessSymbolizer many(fresh, &pool);
+    start = std::chrono::steady_clock::now();
+    many.scan(pids);
+    printf("scan %zu processes %6.1f us  (%zu files parsed)\n", pids.size(), elapsed_us(start), fresh.parsed());
+
+    std::vector<elf_parser::pc_batch_t> batches;
+    for (auto pid : pids)
+        batches.push_back({pid, pcs});
+    start = std::chrono::steady_clock::now();
+    int rounds = 20;
+    size_t found = 0;
+    for (int r = 0; r < rounds; ++r) {
+        for (auto &result : many.resolve(batches))
+            for (auto &f : result.frames)
+                found += f.symbol.found;
+    }
+    double us = elapsed_us(start);
+    printf("resolve %zu x %zu pcs %8.1f ns/pc on %zu threads  (%zu found)\n", batches.size(), pcs.size(),
+           1000 * us / (rounds * batches.size() * pcs.size()), threads, found / rounds);
+
+    for (auto pid : pids) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    many.scan(pids);
+    printf("after exit: %zu objects still held\n", fresh.size());
+
+    printf(failures ? "FAILED\n" : "ok\n");
+    return failures ? 1 : 0;
+}
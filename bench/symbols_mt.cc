@@ -0,0 +1,49 @@
+#include <iostream>
+#include <chrono>
+#include "elf_gen.hpp"
+#include "../elf_parser.hpp"
+#include "../thread_pool.hpp"
+
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./symbols_mt [<symbols>] [<max threads>]\n";
+    if ((argc > 1) && (argv[1][0] == '-')) {
+        std::cerr << usage_banner;
+        return -1;
+    }
+
+    size_t nsyms = (argc > 1) ? strtoull(argv[1], nullptr, 0) : 5000000;
+    size_t max_threads = (argc > 2) ? strtoull(argv[2], nullptr, 0) : std::thread::hardware_concurrency();
+
+    std::string program = "/tmp/elf_parser_symbols_mt.o";
+    if (!elf_gen::write_elf(program, 4, nsyms, 0)) {
+        std::cerr << "cannot write " << program << "\n";
+        return -1;
+    }
+
+    printf("%-8s %10s %12s %8s\n", "Threads", "Symbols", "ms", "Speedup");
+    double serial_ms = 0;
+    for (size_t threads = 0; ; threads = threads ? std::min(threads * 2, max_threads) : 1) {
+        elf_parser::Elf_parser elf_parser(program);
+        std::unique_ptr<elf_parser::ThreadPool> pool;
+        if (threads) {
+            pool.reset(new elf_parser::ThreadPool(threads));
+            elf_parser.set_parallel_decode([&](size_t n, const std::function<void(size_t)> &fn) {
+                pool->parallel_for(n, fn);
+            });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        size_t n = elf_parser.get_symbols().size();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if (threads == 0)
+            serial_ms = ms;
+        printf("%-8s %10zu %12.1f %7.2fx\n",
+               threads ? std::to_string(threads).c_str() : "serial", n, ms, serial_ms / ms);
+
+        if (threads >= max_threads)
+            break;
+    }
+    remove(program.c_str());
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <iostream>
+#include <chrono>
+#include <new>
+#include <inttypes.h> // PRIu64
+#include "../elf_parser.hpp"
+
+// counts every heap allocation made by the process
+static uint64_t g_allocs = 0;
+
+void *operator new(size_t size) {
+    ++g_allocs;
+    if (void *p = malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+template <typename F>
+static void measure(const char *label, uint64_t nsyms, F fn) {
+    uint64_t allocs = g_allocs;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t checksum = fn();
+    auto stop = std::chrono::steady_clock::now();
+    allocs = g_allocs - allocs;
+
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+    printf("%-12s %10" PRIu64 " symbols %10.2f ns/sym %8.3f allocs/sym (checksum %" PRIu64 ")\n",
+           label, nsyms, ns / nsyms, (double)allocs / nsyms, checksum);
+}
+
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./views [<executable>]\n";
+    if(argc < 2) {
+        std::cerr << usage_banner;
+        return -1;
+    }
+
+    std::string program((std::string)argv[1]);
+    elf_parser::Elf_parser elf_parser(program);
+
+    uint64_t nsyms = 0;
+    for (auto sec : elf_parser.sections())
+        if (sec.header->sh_type == SHT_SYMTAB || sec.header->sh_type == SHT_DYNSYM)
+            nsyms += elf_parser.symbols(sec).size();
+    if (nsyms == 0) {
+        std::cerr << "no symbols\n";
+        return -1;
+    }
+
+    measure("get_symbols", nsyms, [&] {
+        uint64_t sum = 0;
+        for (auto &sym : elf_parser.get_symbols())
+            sum += sym.symbol_name.size() + sym.symbol_value;
+        return sum;
+    });
+
+    measure("cached", nsyms, [&] {
+        uint64_t sum = 0;
+        for (auto &sym : elf_parser.get_symbols())
+            sum += sym.symbol_name.size() + sym.symbol_value;
+        return sum;
+    });
+
+    measure("views", nsyms, [&] {
+        uint64_t sum = 0;
+        for (auto sec : elf_parser.sections()) {
+            if (sec.header->sh_type != SHT_SYMTAB && sec.header->sh_type != SHT_DYNSYM)
+                continue;
+            for (auto sym : elf_parser.symbols(sec))
+                sum += sym.name.size() + sym.sym->st_value;
+        }
+        return sum;
+    });
+    return 0;
+}
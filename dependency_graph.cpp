@@ -0,0 +1,321 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include "dependency_graph.hpp"
+using namespace elf_parser;
+
+ObjectCache::ObjectCache(const loader_options_t &options) : m_options{options} {}
+
+std::shared_ptr<const shared_object_t> ObjectCache::get(const std::string &path) {
+    ++m_lookups;
+    std::shared_ptr<entry_t> entry;
+    bool known = false;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        auto it = m_by_path.find(path);
+        if (it != m_by_path.end()) {
+            entry = it->second;
+            known = true;
+        }
+    }
+    if (!known) {
+        struct stat st;
+        bool exists = (stat(path.c_str(), &st) == 0) && S_ISREG(st.st_mode);
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (exists) {
+            auto &slot = m_by_inode[{st.st_dev, st.st_ino}];
+            if (!slot) {
+                slot = std::make_shared<entry_t>();
+                slot->object = std::make_shared<shared_object_t>();
+                slot->object->path = path;
+                slot->object->dev = st.st_dev;
+                slot->object->ino = st.st_ino;
+            }
+            entry = slot;
+        }
+        m_by_path.emplace(path, entry);
+    }
+    if (!entry)
+        return nullptr;
+
+    std::call_once(entry->once, [&] {
+        shared_object_t &object = *entry->object;
+        if (char *real = realpath(object.path.c_str(), nullptr)) {
+            std::string dir(real);
+            free(real);
+            size_t slash = dir.rfind('/');
+            object.origin = (slash == 0) ? "/" : dir.substr(0, slash);
+        }
+        try {
+            Elf_parser elf(object.path);
+            object.elf_class = elf.get_elf_class();
+            object.machine = elf.get_machine();
+            object.dynamic = elf.get_dynamic_info();
+        } catch (const std::exception &e) {
+            object.error = e.what();
+        }
+        ++m_parsed;
+    });
+    return entry->object;
+}
+
+const std::vector<std::string> &ObjectCache::ld_cache_lookup(const std::string &soname) {
+    static const std::vector<std::string> none;
+    std::call_once(m_ld_cache_once, [this] { load_ld_cache(); });
+    auto it = m_ld_cache.find(soname);
+    return (it == m_ld_cache.end()) ? none : it->second;
+}
+
+/* glibc's cache file: an optional "ld.so-1.7.0" table of 12-byte entries,
+ * then the "glibc-ld.so.cache1.1" table of 24-byte entries whose string
+ * offsets are relative to its own header */
+void ObjectCache::load_ld_cache() {
+    if (m_options.ld_cache.empty())
+        return;
+    std::ifstream in(m_options.ld_cache, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    auto u32 = [&](size_t off) {
+        uint32_t value = 0;
+        if (off + 4 <= data.size())
+            memcpy(&value, data.data() + off, 4);
+        return value;
+    };
+    size_t base = 0;
+    if (data.compare(0, 11, "ld.so-1.7.0") == 0)
+        base = (16 + (uint64_t)u32(12) * 12 + 7) & ~(size_t)7;
+
+    static const char magic[] = "glibc-ld.so.cache1.1";
+    if ((base + 48 > data.size()) || (data.compare(base, sizeof(magic) - 1, magic) != 0))
+        return;
+    uint64_t nlibs = u32(base + 20);
+    if (nlibs > (data.size() - base - 48) / 24)
+        return;
+
+    auto string_at = [&](uint32_t off) -> std::string {
+        if (base + off >= data.size())
+            return std::string();
+        const char *s = data.data() + base + off;
+        return std::string(s, strnlen(s, data.size() - base - off));
+    };
+    for (uint64_t i = 0; i < nlibs; ++i) {
+        size_t entry = base + 48 + i * 24;
+        std::string key = string_at(u32(entry + 4)), value = string_at(u32(entry + 8));
+        if (!key.empty() && !value.empty())
+            m_ld_cache[key].push_back(value);
+    }
+}
+
+/* substitute $ORIGIN, $LIB and $PLATFORM, braced or not; empty when a token
+ * has no value */
+static std::string expand_tokens(const std::string &path, const shared_object_t &owner,
+                                 const loader_options_t &options) {
+    static const struct { const char *name; int which; } tokens[] = {
+        {"ORIGIN", 0}, {"LIB", 1}, {"PLATFORM", 2},
+    };
+    std::string out;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] != '$') {
+            out += path[i];
+            continue;
+        }
+        bool braced = (i + 1 < path.size()) && (path[i + 1] == '{');
+        size_t start = i + 1 + braced;
+        bool matched = false;
+        for (auto &token : tokens) {
+            size_t len = strlen(token.name);
+            if (path.compare(start, len, token.name) != 0)
+                continue;
+            size_t end = start + len;
+            if (braced) {
+                if ((end >= path.size()) || (path[end] != '}'))
+                    continue;
+                ++end;
+            } else if ((end < path.size()) && (isalnum((unsigned char)path[end]) || (path[end] == '_'))) {
+                continue;
+            }
+            const std::string *value = &options.platform;
+            if (token.which == 0)
+                value = &owner.origin;
+            else if (token.which == 1)
+                value = &options.lib;
+            if (value->empty())
+                return std::string();
+            out += *value;
+            i = end - 1;
+            matched = true;
+            break;
+        }
+        if (!matched)
+            out += '$';
+    }
+    return out;
+}
+
+DependencyGraph::DependencyGraph(const std::string &root, ObjectCache &cache, ThreadPool *pool)
+    : m_cache{cache} {
+    auto object = m_cache.get(root);
+    if (!object)
+        throw Elf_error("cannot open " + root, Elf_errc::io);
+    if (!object->error.empty())
+        throw Elf_error(object->error);
+    m_nodes.push_back({object, root, -1, {}});
+    if (!object->dynamic.soname.empty())
+        m_by_name[object->dynamic.soname] = 0;
+
+    std::map<std::pair<dev_t, ino_t>, int> by_inode{{{object->dev, object->ino}, 0}};
+
+    /* one breadth-first level at a time: search for every DT_NEEDED name
+     * of the level at once, then add the results in load order */
+    size_t begin = 0;
+    while (begin < m_nodes.size()) {
+        size_t end = m_nodes.size();
+        std::vector<std::pair<int, size_t>> work;    // (node, DT_NEEDED index)
+        for (size_t n = begin; n < end; ++n) {
+            auto &needed = m_nodes[n].object->dynamic.needed;
+            for (size_t j = 0; j < needed.size(); ++j) {
+                if (!m_by_name.count(needed[j]))
+                    work.push_back({(int)n, j});
+            }
+        }
+        std::vector<std::shared_ptr<const shared_object_t>> found(work.size());
+        auto resolve = [&](size_t w) {
+            auto &needed = m_nodes[work[w].first].object->dynamic.needed;
+            found[w] = search(work[w].first, needed[work[w].second]);
+        };
+        if (pool && (work.size() > 1)) {
+            pool->parallel_for(work.size(), resolve);
+        } else {
+            for (size_t w = 0; w < work.size(); ++w)
+                resolve(w);
+        }
+
+        size_t w = 0;
+        for (size_t n = begin; n < end; ++n) {
+            auto object = m_nodes[n].object;    // push_back below moves the nodes
+            auto &needed = object->dynamic.needed;
+            for (size_t j = 0; j < needed.size(); ++j) {
+                std::shared_ptr<const shared_object_t> hit;
+                if ((w < work.size()) && (work[w].first == (int)n) && (work[w].second == j))
+                    hit = found[w++];
+
+                int index = -1;
+                auto named = m_by_name.find(needed[j]);
+                if (named != m_by_name.end()) {
+                    index = named->second;
+                } else if (hit) {
+                    auto seen = by_inode.find({hit->dev, hit->ino});
+                    if (seen != by_inode.end()) {
+                        index = seen->second;
+                    } else {
+                        index = (int)m_nodes.size();
+                        m_nodes.push_back({hit, needed[j], (int)n, {}});
+                        by_inode[{hit->dev, hit->ino}] = index;
+                        if (!hit->dynamic.soname.empty())
+                            m_by_name.emplace(hit->dynamic.soname, index);
+                    }
+                    m_by_name[needed[j]] = index;
+                }
+                m_nodes[n].needed.push_back(index);
+            }
+        }
+        begin = end;
+    }
+}
+
+bool DependencyGraph::compatible(const shared_object_t &object) const {
+    const shared_object_t &root = *m_nodes[0].object;
+    return object.error.empty() && (object.elf_class == root.elf_class) &&
+           (object.machine == root.machine);
+}
+
+std::shared_ptr<const shared_object_t> DependencyGraph::search_dirs(
+        const std::vector<std::string> &dirs, const shared_object_t &owner,
+        const std::string &name) const {
+    for (auto &dir : dirs) {
+        std::string expanded = expand_tokens(dir, owner, m_cache.options());
+        if (expanded.empty() && !dir.empty())
+            continue;
+        if (expanded.empty())
+            expanded = ".";
+        auto object = m_cache.get(expanded + "/" + name);
+        if (object && compatible(*object))
+            return object;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const shared_object_t> DependencyGraph::search(int node, const std::string &name) const {
+    const shared_object_t &owner = *m_nodes[node].object;
+    const loader_options_t &options = m_cache.options();
+
+    if (name.find('/') != std::string::npos) {
+        std::string path = expand_tokens(name, owner, options);
+        auto object = path.empty() ? nullptr : m_cache.get(path);
+        return (object && compatible(*object)) ? object : nullptr;
+    }
+    /* DT_RPATH is ignored by objects that also carry DT_RUNPATH */
+    if (owner.dynamic.runpath.empty()) {
+        for (int n = node; n >= 0; n = m_nodes[n].loader) {
+            const shared_object_t &loader = *m_nodes[n].object;
+            if (!loader.dynamic.runpath.empty())
+                continue;
+            if (auto object = search_dirs(loader.dynamic.rpath, loader, name))
+                return object;
+        }
+    }
+    /* LD_LIBRARY_PATH expands $ORIGIN against the executable */
+    if (auto object = search_dirs(options.library_path, *m_nodes[0].object, name))
+        return object;
+    if (auto object = search_dirs(owner.dynamic.runpath, owner, name))
+        return object;
+    if (owner.dynamic.flags_1 & DF_1_NODEFLIB)
+        return nullptr;
+    for (auto &path : m_cache.ld_cache_lookup(name)) {
+        auto object = m_cache.get(path);
+        if (object && compatible(*object))
+            return object;
+    }
+    return search_dirs(options.default_dirs, owner, name);
+}
+
+std::vector<std::string> DependencyGraph::missing() const {
+    std::vector<std::string> names;
+    for (auto &node : m_nodes) {
+        for (size_t j = 0; j < node.needed.size(); ++j) {
+            auto &name = node.object->dynamic.needed[j];
+            if ((node.needed[j] < 0) && (std::find(names.begin(), names.end(), name) == names.end()))
+                names.push_back(name);
+        }
+    }
+    return names;
+}
+
+int DependencyGraph::find(const std::string &name) const {
+    auto it = m_by_name.find(name);
+    return (it == m_by_name.end()) ? -1 : it->second;
+}
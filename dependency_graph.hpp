@@ -0,0 +1,143 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_DEPENDENCY_GRAPH
+#define H_DEPENDENCY_GRAPH
+
+#include <map>
+#include <sys/types.h>
+#include "elf_parser.hpp"
+#include "thread_pool.hpp"
+
+namespace elf_parser {
+
+/* what the resolver keeps of a parsed shared object */
+typedef struct {
+    std::string path;           // as opened
+    std::string origin;         // directory of the real path, for $ORIGIN
+    dev_t dev = 0;
+    ino_t ino = 0;
+    int elf_class = 0;
+    uint16_t machine = 0;
+    dynamic_info_t dynamic;
+    std::string error;          // set when the file is not a usable ELF file
+} shared_object_t;
+
+/* how the loader is emulated */
+typedef struct {
+    std::vector<std::string> library_path;      // LD_LIBRARY_PATH, in order
+    std::string ld_cache = "/etc/ld.so.cache";  // empty to skip the cache
+    std::vector<std::string> default_dirs = {"/lib64", "/usr/lib64", "/lib", "/usr/lib"};
+    /* expansions for $LIB and $PLATFORM; search path entries using a
+     * token left empty are dropped, as ld.so does */
+    std::string lib, platform;
+} loader_options_t;
+
+/* Parsed shared objects, shared by every graph built against it. Each file
+ * is parsed at most once, keyed by device and inode so that symlinks and
+ * hard links share an entry, and every path probed is remembered, hit or
+ * miss. Safe to use from several threads; concurrent requests for the same
+ * file wait for one parse. */
+class ObjectCache {
+    public:
+        explicit ObjectCache(const loader_options_t &options = loader_options_t());
+
+        /* null when nothing exists at path; otherwise the object, with
+         * error set if it could not be parsed */
+        std::shared_ptr<const shared_object_t> get(const std::string &path);
+
+        /* ld.so.cache paths for soname, best first; read on first use */
+        const std::vector<std::string> &ld_cache_lookup(const std::string &soname);
+
+        const loader_options_t &options() const { return m_options; }
+
+        size_t parsed() const { return m_parsed; }
+        size_t lookups() const { return m_lookups; }
+
+    private:
+        typedef struct {
+            std::once_flag once;
+            std::shared_ptr<shared_object_t> object;
+        } entry_t;
+
+        void load_ld_cache();
+
+        loader_options_t m_options;
+
+        std::mutex m_lock;
+        std::unordered_map<std::string, std::shared_ptr<entry_t>> m_by_path;   // null entry: no file
+        std::map<std::pair<dev_t, ino_t>, std::shared_ptr<entry_t>> m_by_inode;
+        std::atomic<size_t> m_parsed{0}, m_lookups{0};
+
+        std::once_flag m_ld_cache_once;
+        std::unordered_map<std::string, std::vector<std::string>> m_ld_cache;
+};
+
+typedef struct {
+    std::shared_ptr<const shared_object_t> object;
+    std::string name;           // the DT_NEEDED string it was loaded for
+    int loader = -1;            // node whose DT_NEEDED pulled it in
+    /* one index per DT_NEEDED entry of object, -1 when not found */
+    std::vector<int> needed;
+} dependency_node_t;
+
+/* ldd-style closure of one executable or shared object. Dependencies are
+ * loaded breadth first, the order ld.so uses, and each name is resolved
+ * the way ld.so does it:
+ *   - a name already loaded, by SONAME or by the name it was loaded for;
+ *   - a name containing '/' is a path;
+ *   - DT_RPATH of the object and of its loaders, unless it has DT_RUNPATH;
+ *   - library_path;
+ *   - DT_RUNPATH of the object;
+ *   - ld.so.cache and the default directories, unless DF_1_NODEFLIB.
+ * $ORIGIN, $LIB and $PLATFORM are expanded, and candidates of another
+ * class or machine than the root are skipped. With a pool, the searches for
+ * each breadth-first level run in parallel; the graph does not depend on
+ * it. Throws Elf_error when the root cannot be parsed. */
+class DependencyGraph {
+    public:
+        DependencyGraph(const std::string &root, ObjectCache &cache,
+                        ThreadPool *pool = nullptr);
+
+        /* load order; nodes()[0] is the root */
+        const std::vector<dependency_node_t> &nodes() const { return m_nodes; }
+
+        /* DT_NEEDED names that could not be found, without duplicates */
+        std::vector<std::string> missing() const;
+
+        /* node loaded for name or with that SONAME, -1 when none */
+        int find(const std::string &name) const;
+
+    private:
+        std::shared_ptr<const shared_object_t> search(int node, const std::string &name) const;
+        std::shared_ptr<const shared_object_t> search_dirs(
+            const std::vector<std::string> &dirs, const shared_object_t &owner,
+            const std::string &name) const;
+        bool compatible(const shared_object_t &object) const;
+
+        ObjectCache &m_cache;
+        std::vector<dependency_node_t> m_nodes;
+        std::unordered_map<std::string, int> m_by_name;
+};
+
+}
+#endif
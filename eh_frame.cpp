@@ -0,0 +1,442 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstring>
+#include "eh_frame.hpp"
+using namespace elf_parser;
+
+static const unsigned char host_data =
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) ? ELFDATA2LSB : ELFDATA2MSB;
+
+/* reads .eh_frame and .eh_frame_hdr fields in the file's byte order and
+ * pointer size; data starts at virtual address addr */
+class EhFrame::Cursor {
+    public:
+        Cursor(std::string_view data, uint64_t addr, size_t pos, bool swap, uint8_t ptr_size)
+            : m_data{data}, m_addr{addr}, m_pos{pos}, m_swap{swap}, m_ptr_size{ptr_size} {
+            if (pos > data.size())
+                throw Elf_error("Err: .eh_frame offset out of range");
+        }
+
+        size_t pos() const { return m_pos; }
+        bool at_end() const { return m_pos >= m_data.size(); }
+        size_t remaining() const { return m_data.size() - m_pos; }
+
+        void seek(size_t pos) {
+            if (pos > m_data.size())
+                throw Elf_error("Err: truncated .eh_frame entry");
+            m_pos = pos;
+        }
+
+        template <typename T> T read() {
+            need(sizeof(T));
+            T value;
+            memcpy(&value, m_data.data() + m_pos, sizeof(T));
+            m_pos += sizeof(T);
+            if (m_swap) {
+                if constexpr (sizeof(T) == 2) value = (T)__builtin_bswap16((uint16_t)value);
+                if constexpr (sizeof(T) == 4) value = (T)__builtin_bswap32((uint32_t)value);
+                if constexpr (sizeof(T) == 8) value = (T)__builtin_bswap64((uint64_t)value);
+            }
+            return value;
+        }
+
+        uint64_t uleb() {
+            uint64_t value = 0;
+            for (unsigned shift = 0; ; shift += 7) {
+                uint8_t byte = read<uint8_t>();
+                if (shift < 64)
+                    value |= (uint64_t)(byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    return value;
+            }
+        }
+
+        int64_t sleb() {
+            uint64_t value = 0;
+            unsigned shift = 0;
+            uint8_t byte;
+            do {
+                byte = read<uint8_t>();
+                if (shift < 64)
+                    value |= (uint64_t)(byte & 0x7f) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+            if ((shift < 64) && (byte & 0x40))
+                value |= ~0ull << shift;
+            return (int64_t)value;
+        }
+
+        std::string_view cstr() {
+            size_t len = strnlen(m_data.data() + m_pos, remaining());
+            need(len + 1);
+            std::string_view s(m_data.data() + m_pos, len);
+            m_pos += len + 1;
+            return s;
+        }
+
+        /* a DW_EH_PE_* encoded pointer; datarel is the DW_EH_PE_datarel base.
+         * textrel and funcrel values are returned unadjusted */
+        uint64_t encoded(uint8_t enc, uint64_t datarel = 0) {
+            if (enc == DW_EH_PE_omit)
+                return 0;
+            uint64_t field = m_addr + m_pos, value;
+            switch (enc & 0x0f) {
+                case DW_EH_PE_absptr:
+                    value = (m_ptr_size == 8) ? read<uint64_t>() : read<uint32_t>();
+                    break;
+                case DW_EH_PE_uleb128: value = uleb(); break;
+                case DW_EH_PE_udata2: value = read<uint16_t>(); break;
+                case DW_EH_PE_udata4: value = read<uint32_t>(); break;
+                case DW_EH_PE_udata8: value = read<uint64_t>(); break;
+                case DW_EH_PE_sleb128: value = (uint64_t)sleb(); break;
+                case DW_EH_PE_sdata2: value = (uint64_t)(int64_t)read<int16_t>(); break;
+                case DW_EH_PE_sdata4: value = (uint64_t)(int64_t)read<int32_t>(); break;
+                case DW_EH_PE_sdata8: value = (uint64_t)read<int64_t>(); break;
+                default:
+                    throw Elf_error("Err: unsupported pointer encoding " + std::to_string(enc),
+                                    Elf_errc::unsupported);
+            }
+            switch (enc & 0x70) {
+                case DW_EH_PE_pcrel: value += field; break;
+                case DW_EH_PE_datarel: value += datarel; break;
+                case DW_EH_PE_aligned:
+                    throw Elf_error("Err: unsupported pointer encoding " + std::to_string(enc),
+                                    Elf_errc::unsupported);
+                default: break;
+            }
+            return (m_ptr_size == 4) ? (uint32_t)value : value;
+        }
+
+        /* the length and CIE id / pointer that start every entry; false on
+         * the zero terminator. end is where the entry stops */
+        bool entry_header(size_t &end, uint64_t &id, size_t &id_pos) {
+            uint64_t length = read<uint32_t>();
+            if (length == 0)
+                return false;
+            bool dwarf64 = length == 0xffffffff;
+            if (dwarf64)
+                length = read<uint64_t>();
+            if (length > remaining())
+                throw Elf_error("Err: truncated .eh_frame entry");
+            end = m_pos + length;
+            id_pos = m_pos;
+            id = dwarf64 ? read<uint64_t>() : read<uint32_t>();
+            return true;
+        }
+
+    private:
+        void need(size_t n) const {
+            if (n > remaining())
+                throw Elf_error("Err: truncated .eh_frame entry");
+        }
+
+        std::string_view m_data;
+        uint64_t m_addr;
+        size_t m_pos;
+        bool m_swap;
+        uint8_t m_ptr_size;
+};
+
+EhFrame::Cursor EhFrame::cursor(uint64_t offset) const {
+    return Cursor(m_frame, m_frame_addr, offset, m_swap, m_ptr_size);
+}
+
+EhFrame::EhFrame(const Elf_parser &elf, bool use_header)
+        : m_cie_memo{new std::atomic<uint64_t>[cie_memo_size]()} {
+    m_swap = (elf.get_elf_data() != ELFDATANONE) && (elf.get_elf_data() != host_data);
+    m_ptr_size = (elf.get_elf_class() == ELFCLASS32) ? 4 : 8;
+
+    if (auto sec = elf.find_section(".eh_frame")) {
+        m_frame = elf.section_data(*sec, m_keep_frame);
+        m_frame_addr = sec->header->sh_addr;
+    }
+    std::string_view hdr;
+    uint64_t hdr_addr = 0;
+    if (auto sec = elf.find_section(".eh_frame_hdr")) {
+        hdr = elf.section_data(*sec, m_keep_hdr);
+        hdr_addr = sec->header->sh_addr;
+    } else {
+        for (auto &seg : elf.get_segments())
+            if (seg.segment_type == "GNU_EH_FRAME") {
+                hdr_addr = seg.segment_virtaddr;
+                hdr = elf.address_data(hdr_addr, seg.segment_filesize, m_keep_hdr);
+                break;
+            }
+    }
+    // stripped section headers: the header says where .eh_frame is
+    if (m_frame.empty() && (hdr.size() >= 4)) {
+        Cursor c(hdr, hdr_addr, 4, m_swap, m_ptr_size);
+        m_frame_addr = c.encoded(hdr[1], hdr_addr);
+        m_frame = elf.address_data(m_frame_addr, ~0ull, m_keep_frame);
+    }
+    if (use_header && !hdr.empty())
+        load_header(hdr, hdr_addr);
+    if (!from_header())
+        scan();
+}
+
+/* version, eh_frame_ptr_enc, fde_count_enc, table_enc, eh_frame_ptr,
+ * fde_count, then fde_count (initial location, FDE address) pairs */
+void EhFrame::load_header(std::string_view hdr, uint64_t hdr_addr) {
+    Cursor c(hdr, hdr_addr, 0, m_swap, m_ptr_size);
+    if (c.read<uint8_t>() != 1)
+        throw Elf_error("Err: unknown .eh_frame_hdr version", Elf_errc::unsupported);
+    uint8_t ptr_enc = c.read<uint8_t>(), count_enc = c.read<uint8_t>(), table_enc = c.read<uint8_t>();
+    uint64_t frame_addr = c.encoded(ptr_enc, hdr_addr);
+    if ((count_enc == DW_EH_PE_omit) || (table_enc == DW_EH_PE_omit))
+        return;
+    uint64_t count = c.encoded(count_enc, hdr_addr);
+
+    // binary search needs fixed-size fields
+    uint8_t size;
+    switch (table_enc & 0x0f) {
+        case DW_EH_PE_udata2: case DW_EH_PE_sdata2: size = 2; break;
+        case DW_EH_PE_udata4: case DW_EH_PE_sdata4: size = 4; break;
+        case DW_EH_PE_udata8: case DW_EH_PE_sdata8: size = 8; break;
+        case DW_EH_PE_absptr: size = m_ptr_size; break;
+        default: return;
+    }
+    if (((table_enc & 0x70) != 0) && ((table_enc & 0x70) != DW_EH_PE_datarel))
+        return;
+    if (count > c.remaining() / (2 * size))
+        throw Elf_error("Err: truncated .eh_frame_hdr table");
+    if (m_frame.empty() || (frame_addr != m_frame_addr))
+        return;
+
+    m_hdr_addr = hdr_addr;
+    m_table_enc = table_enc;
+    m_field_size = size;
+    m_table_data = (const uint8_t*)hdr.data() + c.pos();
+    m_count = count;
+}
+
+std::pair<uint64_t, uint64_t> EhFrame::entry(size_t i) const {
+    if (!m_table_data)
+        return m_table[i];
+
+    // the layout every linker emits, read in place
+    if ((m_table_enc == (DW_EH_PE_datarel | DW_EH_PE_sdata4)) && !m_swap) {
+        int32_t pair[2];
+        memcpy(pair, m_table_data + i * 8, 8);
+        uint64_t pc = m_hdr_addr + pair[0], fde = m_hdr_addr + pair[1];
+        if (m_ptr_size == 4)
+            pc = (uint32_t)pc, fde = (uint32_t)fde;
+        return {pc, fde - m_frame_addr};
+    }
+    std::string_view fields((const char*)m_table_data + i * 2 * m_field_size, 2 * m_field_size);
+    Cursor c(fields, 0, 0, m_swap, m_ptr_size);
+    uint64_t pc = c.encoded(m_table_enc, m_hdr_addr);
+    uint64_t fde = c.encoded(m_table_enc, m_hdr_addr);
+    return {pc, fde - m_frame_addr};
+}
+
+void EhFrame::scan() {
+    Cursor c = cursor(0);
+    size_t end, id_pos;
+    uint64_t id;
+    while (!c.at_end()) {
+        size_t start = c.pos();
+        if (!c.entry_header(end, id, id_pos))
+            break;
+        if (id != 0) {
+            fde_t fde = fde_at(start);
+            if (fde.pc_end > fde.pc_begin)
+                m_table.push_back({fde.pc_begin, start});
+        }
+        c.seek(end);
+    }
+    std::stable_sort(m_table.begin(), m_table.end(),
+                     [](auto &a, auto &b) { return a.first < b.first; });
+    m_count = m_table.size();
+}
+
+cie_t EhFrame::cie_at(uint64_t offset) const {
+    Cursor c = cursor(offset);
+    size_t end, id_pos;
+    uint64_t id;
+    if (!c.entry_header(end, id, id_pos) || (id != 0))
+        throw Elf_error("Err: no CIE at .eh_frame offset " + std::to_string(offset));
+
+    cie_t cie;
+    cie.offset = offset;
+    cie.version = c.read<uint8_t>();
+    cie.augmentation = c.cstr();
+    if (cie.augmentation.find("eh") != std::string_view::npos)
+        c.seek(c.pos() + m_ptr_size);      // GCC 2.x exception table pointer
+    cie.code_align = c.uleb();
+    cie.data_align = c.sleb();
+    cie.return_register = (cie.version == 1) ? c.read<uint8_t>() : c.uleb();
+
+    if (!cie.augmentation.empty() && (cie.augmentation[0] == 'z')) {
+        uint64_t length = c.uleb();
+        if (length > c.remaining())
+            throw Elf_error("Err: truncated .eh_frame entry");
+        size_t data_end = c.pos() + length;
+        for (char ch : cie.augmentation.substr(1)) {
+            if (ch == 'L') {
+                cie.lsda_encoding = c.read<uint8_t>();
+            } else if (ch == 'P') {
+                cie.personality_encoding = c.read<uint8_t>();
+                cie.personality = c.encoded(cie.personality_encoding);
+            } else if (ch == 'R') {
+                cie.fde_encoding = c.read<uint8_t>();
+            } else if (ch == 'S') {
+                cie.signal_frame = true;
+            } else if ((ch != 'B') && (ch != 'G')) {
+                break;      // unknown: the augmentation length skips the rest
+            }
+        }
+        c.seek(data_end);
+    }
+    if (c.pos() > end)
+        throw Elf_error("Err: truncated .eh_frame entry");
+    cie.instructions = m_frame.substr(c.pos(), end - c.pos());
+    return cie;
+}
+
+EhFrame::encodings_t EhFrame::cie_encodings(uint64_t cie_offset) const {
+    auto &slot = m_cie_memo[(cie_offset >> 3) % cie_memo_size];
+    uint64_t packed = slot.load(std::memory_order_relaxed);
+    if ((packed >> 18 == cie_offset) && (packed & (1 << 17)))
+        return {(uint8_t)packed, (uint8_t)(packed >> 8), (packed & (1 << 16)) != 0};
+
+    cie_t cie = cie_at(cie_offset);
+    encodings_t enc{cie.fde_encoding, cie.lsda_encoding,
+                    !cie.augmentation.empty() && (cie.augmentation[0] == 'z')};
+    if (cie_offset < (1ull << 46))
+        slot.store(cie_offset << 18 | 1 << 17 | (uint64_t)enc.augmented << 16 |
+                   enc.lsda << 8 | enc.fde, std::memory_order_relaxed);
+    return enc;
+}
+
+fde_t EhFrame::fde_at(uint64_t offset) const {
+    Cursor c = cursor(offset);
+    size_t end, id_pos;
+    uint64_t id;
+    if (!c.entry_header(end, id, id_pos) || (id == 0) || (id > id_pos))
+        throw Elf_error("Err: no FDE at .eh_frame offset " + std::to_string(offset));
+
+    fde_t fde;
+    fde.offset = offset;
+    fde.cie_offset = id_pos - id;
+    encodings_t enc = cie_encodings(fde.cie_offset);
+    fde.pc_begin = c.encoded(enc.fde);
+    fde.pc_end = fde.pc_begin + c.encoded(enc.fde & 0x0f);
+    if (enc.augmented) {
+        uint64_t length = c.uleb();
+        if (length > c.remaining())
+            throw Elf_error("Err: truncated .eh_frame entry");
+        size_t data_end = c.pos() + length;
+        fde.lsda = c.encoded(enc.lsda);
+        c.seek(data_end);
+    }
+    if (c.pos() > end)
+        throw Elf_error("Err: truncated .eh_frame entry");
+    fde.instructions = m_frame.substr(c.pos(), end - c.pos());
+    return fde;
+}
+
+size_t EhFrame::upper_bound(uint64_t pc, size_t lo, size_t hi) const {
+    if (m_table_data && (m_table_enc == (DW_EH_PE_datarel | DW_EH_PE_sdata4)) && !m_swap
+            && (m_ptr_size == 8)) {
+        // compare hdr-relative locations; they are sorted as signed values
+        int64_t rel = (int64_t)(pc - m_hdr_addr);
+        if (rel < INT32_MIN)
+            return lo;
+        auto location = [this](size_t i) {
+            int32_t loc;
+            memcpy(&loc, m_table_data + i * 8, 4);
+            return loc;
+        };
+        if (lo >= hi)
+            return lo;
+        // branch-free: the answer stays in [lo, lo + n]
+        size_t n = hi - lo;
+        while (n > 1) {
+            size_t half = n / 2;
+            lo = (location(lo + half) <= rel) ? lo + half : lo;
+            n -= half;
+        }
+        return lo + (location(lo) <= rel);
+    }
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (entry(mid).first <= pc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+std::optional<fde_t> EhFrame::find(uint64_t pc) const {
+    size_t i = upper_bound(pc, 0, m_count);
+    if (i == 0)
+        return std::nullopt;
+    fde_t fde = fde_at(entry(i - 1).second);
+    if ((pc < fde.pc_begin) || (pc >= fde.pc_end))
+        return std::nullopt;
+    return fde;
+}
+
+uint64_t EhFrame::lookup(uint64_t pc) const {
+    auto fde = find(pc);
+    return fde ? fde->offset : npos;
+}
+
+std::vector<uint64_t> EhFrame::lookup(std::span<const uint64_t> pcs) const {
+    std::vector<uint64_t> out(pcs.size(), npos);
+
+    // [begin, end) is the last range found, answer is its FDE or npos
+    uint64_t begin = 1, end = 0, answer = npos;
+    size_t lo = 0;
+    for (size_t k = 0; k < pcs.size(); ++k) {
+        uint64_t pc = pcs[k];
+        if ((pc >= begin) && (pc < end)) {
+            out[k] = answer;
+            continue;
+        }
+        // gallop forward from the previous hit, then binary search
+        size_t step = 1, hi = lo + 1;
+        while ((hi < m_count) && (entry(hi).first <= pc)) {
+            lo = hi;
+            step *= 2;
+            hi = lo + step;
+        }
+        size_t i = upper_bound(pc, lo, std::min(hi, m_count));
+        uint64_t next = (i < m_count) ? entry(i).first : ~0ull;
+        if (i == 0) {
+            begin = 0, end = next, answer = npos;
+        } else {
+            lo = i - 1;
+            fde_t fde = fde_at(entry(i - 1).second);
+            if ((pc >= fde.pc_begin) && (pc < fde.pc_end))
+                begin = fde.pc_begin, end = fde.pc_end, answer = fde.offset;
+            else
+                begin = std::max(fde.pc_end, entry(i - 1).first), end = next, answer = npos;
+        }
+        out[k] = (pc >= begin && pc < end) ? answer : npos;
+    }
+    return out;
+}
@@ -0,0 +1,134 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_EH_FRAME
+#define H_EH_FRAME
+
+#include <span>
+#include "elf_parser.hpp"
+
+namespace elf_parser {
+
+/* DW_EH_PE_* pointer encodings used by .eh_frame and .eh_frame_hdr */
+enum : uint8_t {
+    DW_EH_PE_absptr = 0x00, DW_EH_PE_uleb128 = 0x01, DW_EH_PE_udata2 = 0x02,
+    DW_EH_PE_udata4 = 0x03, DW_EH_PE_udata8 = 0x04, DW_EH_PE_sleb128 = 0x09,
+    DW_EH_PE_sdata2 = 0x0a, DW_EH_PE_sdata4 = 0x0b, DW_EH_PE_sdata8 = 0x0c,
+    DW_EH_PE_pcrel = 0x10, DW_EH_PE_textrel = 0x20, DW_EH_PE_datarel = 0x30,
+    DW_EH_PE_funcrel = 0x40, DW_EH_PE_aligned = 0x50,
+    DW_EH_PE_indirect = 0x80, DW_EH_PE_omit = 0xff,
+};
+
+/* a Common Information Entry; offsets are from the start of .eh_frame */
+typedef struct {
+    uint64_t offset = 0;
+    uint8_t version = 0;
+    std::string_view augmentation;
+    uint64_t code_align = 0;
+    int64_t data_align = 0;
+    uint64_t return_register = 0;
+    uint8_t fde_encoding = DW_EH_PE_absptr;
+    uint8_t lsda_encoding = DW_EH_PE_omit;
+    uint8_t personality_encoding = DW_EH_PE_omit;
+    /* with DW_EH_PE_indirect, the address of the pointer to the routine */
+    uint64_t personality = 0;
+    bool signal_frame = false;
+    std::string_view instructions;      // initial CFA program
+} cie_t;
+
+/* a Frame Description Entry, covering [pc_begin, pc_end) */
+typedef struct {
+    uint64_t offset = 0, cie_offset = 0;
+    uint64_t pc_begin = 0, pc_end = 0;
+    uint64_t lsda = 0;                  // 0 when there is none
+    std::string_view instructions;
+} fde_t;
+
+/* PC to FDE lookup for an unwinder. The sorted search table of
+ * .eh_frame_hdr (PT_GNU_EH_FRAME) is binary searched in place; when there
+ * is none, .eh_frame is scanned once into an equivalent table kept by this
+ * object. Entries point into the parser, which must outlive it. Throws
+ * Elf_error on a malformed .eh_frame_hdr or a truncated entry. */
+class EhFrame {
+    public:
+        /* use_header = false ignores .eh_frame_hdr and scans .eh_frame */
+        explicit EhFrame(const Elf_parser &elf, bool use_header = true);
+
+        static constexpr uint64_t npos = ~0ull;
+
+        /* offset in .eh_frame of the FDE covering pc, npos when none */
+        uint64_t lookup(uint64_t pc) const;
+        /* lookup() for each of pcs, which must be sorted ascending; runs of
+         * pcs in one function are answered without searching again */
+        std::vector<uint64_t> lookup(std::span<const uint64_t> pcs) const;
+
+        std::optional<fde_t> find(uint64_t pc) const;
+        fde_t fde_at(uint64_t offset) const;
+        cie_t cie_at(uint64_t offset) const;
+
+        /* the search table: initial location and FDE offset, by location */
+        size_t size() const { return m_count; }
+        std::pair<uint64_t, uint64_t> entry(size_t i) const;
+        /* true when the table is the one in .eh_frame_hdr */
+        bool from_header() const { return m_table_data != nullptr; }
+
+        uint64_t eh_frame_address() const { return m_frame_addr; }
+
+    private:
+        class Cursor;
+
+        /* what decoding an FDE needs from its CIE */
+        typedef struct {
+            uint8_t fde, lsda;
+            bool augmented;         // 'z': the FDE has augmentation data
+        } encodings_t;
+
+        void load_header(std::string_view hdr, uint64_t hdr_addr);
+        void scan();
+        size_t upper_bound(uint64_t pc, size_t lo, size_t hi) const;
+        encodings_t cie_encodings(uint64_t cie_offset) const;
+        Cursor cursor(uint64_t offset) const;
+
+        std::string_view m_frame;           // .eh_frame
+        uint64_t m_frame_addr = 0;
+        bool m_swap = false;
+        uint8_t m_ptr_size = 8;
+
+        // .eh_frame_hdr table, searched in place
+        const uint8_t *m_table_data = nullptr;
+        uint64_t m_hdr_addr = 0;
+        uint8_t m_table_enc = DW_EH_PE_omit, m_field_size = 0;
+        // or the table built by scan()
+        std::vector<std::pair<uint64_t, uint64_t>> m_table;
+        size_t m_count = 0;
+
+        /* encodings of recently used CIEs, packed as offset << 18 | valid
+         * << 17 | augmented << 16 | lsda << 8 | fde; a binary has a handful
+         * of CIEs, so lookups rarely parse one */
+        static constexpr size_t cie_memo_size = 8;
+        std::unique_ptr<std::atomic<uint64_t>[]> m_cie_memo;
+
+        std::shared_ptr<const void> m_keep_frame, m_keep_hdr;
+};
+
+}
+#endif
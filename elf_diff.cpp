@@ -0,0 +1,425 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cinttypes>
+#include "elf_diff.hpp"
+using namespace elf_parser;
+
+namespace {
+
+/* one section, segment or symbol as the join sees it */
+typedef struct {
+    uint64_t hash;          // of name for symbols; 0 keeps the few sections
+                            // and segments in plain name order
+    std::string_view name;
+    uint64_t size;
+    uint32_t row;           // table index: orders entries sharing a name
+    uint32_t flags;
+} diff_key_t;
+
+/* keys of one symbol table, sorted in runs and merged */
+typedef struct {
+    SymbolView view;
+    bool exports_only = false;
+    std::vector<diff_key_t> keys;
+    std::vector<std::pair<size_t, size_t>> runs;    // sorted [begin, end)
+} table_keys_t;
+
+}
+
+// symbols keyed per parallel chunk
+static const size_t chunk_size = 16384;
+
+static bool name_less(const diff_key_t &a, const diff_key_t &b) {
+    if (a.hash != b.hash)
+        return a.hash < b.hash;
+    return a.name < b.name;
+}
+
+static bool key_less(const diff_key_t &a, const diff_key_t &b) {
+    if (a.hash != b.hash)
+        return a.hash < b.hash;
+    int c = a.name.compare(b.name);
+    if (c != 0)
+        return c < 0;
+    return a.row < b.row;
+}
+
+// FNV-1a
+static uint64_t name_hash(std::string_view name) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : name)
+        h = (h ^ c) * 0x100000001b3ull;
+    return h;
+}
+
+static bool keep_symbol(const Elf64_Sym *sym, bool exports_only) {
+    uint8_t type = ELF64_ST_TYPE(sym->st_info);
+    if ((type == STT_SECTION) || (type == STT_FILE))
+        return false;
+    if (!exports_only)
+        return true;
+    uint8_t vis = ELF64_ST_VISIBILITY(sym->st_other);
+    if ((sym->st_shndx == SHN_UNDEF) || (ELF64_ST_BIND(sym->st_info) == STB_LOCAL))
+        return false;
+    return (vis == STV_DEFAULT) || (vis == STV_PROTECTED);
+}
+
+static uint32_t segment_flags(const std::string &flags) {
+    uint32_t out = 0;
+    for (char c : flags) {
+        if (c == 'R')
+            out |= PF_R;
+        else if (c == 'W')
+            out |= PF_W;
+        else if (c == 'E')
+            out |= PF_X;
+    }
+    return out;
+}
+
+static void run_all(size_t n, const std::function<void(size_t)> &fn, const diff_options_t &options) {
+    if (options.parallel_for && (n > 1)) {
+        options.parallel_for(n, fn);
+    } else {
+        for (size_t i = 0; i < n; ++i)
+            fn(i);
+    }
+}
+
+/* fill and sort the keys of every table: chunks are keyed and sorted
+ * independently, then neighbouring runs merged pairwise, each round across
+ * all tables at once */
+static void build_keys(const std::vector<table_keys_t*> &tables, const diff_options_t &options) {
+    typedef struct {
+        table_keys_t *table;
+        size_t run, begin, end;
+    } chunk_t;
+    std::vector<chunk_t> chunks;
+    for (auto *table : tables) {
+        size_t n = table->view.size();
+        size_t step = n;
+        if (options.parallel_for && (n >= options.parallel_threshold))
+            step = chunk_size;
+        table->keys.resize(n);
+        for (size_t begin = 0; begin < n; begin += step) {
+            chunks.push_back({table, table->runs.size(), begin, std::min(n, begin + step)});
+            table->runs.push_back({begin, begin});
+        }
+    }
+
+    run_all(chunks.size(), [&](size_t i) {
+        auto &chunk = chunks[i];
+        auto &table = *chunk.table;
+        size_t out = chunk.begin;
+        for (size_t row = std::max<size_t>(chunk.begin, 1); row < chunk.end; ++row) {
+            auto sym = table.view[row];
+            if (sym.name.empty() || !keep_symbol(sym.sym, table.exports_only))
+                continue;
+            table.keys[out++] = {name_hash(sym.name), sym.name, sym.sym->st_size, (uint32_t)row,
+                                 (uint32_t)sym.sym->st_info | ((uint32_t)sym.sym->st_other << 8)};
+        }
+        std::sort(table.keys.begin() + chunk.begin, table.keys.begin() + out, key_less);
+        table.runs[chunk.run].second = out;
+    }, options);
+
+    // close the gaps left by filtered symbols
+    for (auto *table : tables) {
+        auto keys = table->keys.begin();
+        size_t out = 0;
+        for (auto &run : table->runs) {
+            size_t len = run.second - run.first;
+            std::move(keys + run.first, keys + run.second, keys + out);
+            run = {out, out + len};
+            out += len;
+        }
+        table->keys.resize(out);
+    }
+
+    for (;;) {
+        std::vector<std::pair<table_keys_t*, size_t>> merges;   // runs i and i + 1
+        for (auto *table : tables) {
+            for (size_t i = 0; i + 1 < table->runs.size(); i += 2)
+                merges.push_back({table, i});
+        }
+        if (merges.empty())
+            break;
+
+        run_all(merges.size(), [&](size_t m) {
+            auto &table = *merges[m].first;
+            auto &a = table.runs[merges[m].second], &b = table.runs[merges[m].second + 1];
+            auto keys = table.keys.begin();
+            std::inplace_merge(keys + a.first, keys + b.first, keys + b.second, key_less);
+        }, options);
+
+        for (auto *table : tables) {
+            auto &runs = table->runs;
+            size_t out = 0;
+            for (size_t i = 0; i < runs.size(); i += 2) {
+                if (i + 1 < runs.size())
+                    runs[out++] = {runs[i].first, runs[i + 1].second};
+                else
+                    runs[out++] = runs[i];
+            }
+            runs.resize(out);
+        }
+    }
+}
+
+/* walk two sorted key vectors in step; entries sharing a name are paired
+ * in order, and visit gets nullptr for a side that ran out */
+template <typename Visit>
+static void join(const std::vector<diff_key_t> &a, const std::vector<diff_key_t> &b, Visit visit) {
+    size_t i = 0, j = 0;
+    while ((i < a.size()) || (j < b.size())) {
+        bool from_a = (j == b.size()) || ((i < a.size()) && !name_less(b[j], a[i]));
+        const diff_key_t &key = from_a ? a[i] : b[j];
+        size_t end_i = i, end_j = j;
+        while ((end_i < a.size()) && !name_less(key, a[end_i]))
+            ++end_i;
+        while ((end_j < b.size()) && !name_less(key, b[end_j]))
+            ++end_j;
+        for (uint32_t n = 0; (i + n < end_i) || (j + n < end_j); ++n) {
+            const diff_key_t *old_key = (i + n < end_i) ? &a[i + n] : nullptr;
+            const diff_key_t *new_key = (j + n < end_j) ? &b[j + n] : nullptr;
+            visit(old_key, new_key, n);
+        }
+        i = end_i;
+        j = end_j;
+    }
+}
+
+static std::vector<diff_key_t> section_keys(const SectionView &sections) {
+    std::vector<diff_key_t> keys;
+    keys.reserve(sections.size());
+    for (auto sec : sections) {
+        if (sec.index && !sec.name.empty())
+            keys.push_back({0, sec.name, sec.header->sh_size, (uint32_t)sec.index, 0});
+    }
+    std::sort(keys.begin(), keys.end(), key_less);
+    return keys;
+}
+
+static std::vector<diff_key_t> segment_keys(const std::vector<segment_t> &segments) {
+    std::vector<diff_key_t> keys;
+    keys.reserve(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i) {
+        keys.push_back({0, segments[i].segment_type, (uint64_t)segments[i].segment_memsize,
+                        (uint32_t)i, segment_flags(segments[i].segment_flags)});
+    }
+    std::sort(keys.begin(), keys.end(), key_less);
+    return keys;
+}
+
+diff_summary_t elf_parser::diff(const Elf_parser &old_elf, const Elf_parser &new_elf,
+                                const diff_sink_t &sink, const diff_options_t &options) {
+    diff_summary_t summary;
+
+    auto report = [&](diff_scope_t scope, const diff_key_t *old_key, const diff_key_t *new_key, uint32_t ordinal) {
+        diff_entry_t entry;
+        entry.scope = scope;
+        entry.name = (old_key ? old_key : new_key)->name;
+        entry.ordinal = ordinal;
+        if (old_key) {
+            entry.old_size = old_key->size;
+            entry.old_flags = old_key->flags;
+        }
+        if (new_key) {
+            entry.new_size = new_key->size;
+            entry.new_flags = new_key->flags;
+        }
+
+        if (!old_key) {
+            entry.change = diff_change_t::added;
+            ++summary.added;
+        } else if (!new_key) {
+            entry.change = diff_change_t::removed;
+            ++summary.removed;
+        } else if (entry.old_flags != entry.new_flags) {
+            entry.change = diff_change_t::changed;
+            ++summary.changed;
+        } else if (entry.old_size != entry.new_size) {
+            entry.change = diff_change_t::resized;
+            ++summary.resized;
+        } else {
+            return false;
+        }
+        sink(entry);
+        return true;
+    };
+
+    if (options.sections) {
+        auto old_sections = old_elf.sections(), new_sections = new_elf.sections();
+        // a section adds to the file unless NOBITS, to the image if ALLOC
+        auto account = [&](const SectionView &view, const diff_key_t *key, int64_t sign) {
+            if (!key)
+                return;
+            auto header = view[key->row].header;
+            if (header->sh_type != SHT_NOBITS)
+                summary.file_bytes += sign * (int64_t)key->size;
+            if (header->sh_flags & SHF_ALLOC)
+                summary.alloc_bytes += sign * (int64_t)key->size;
+        };
+        join(section_keys(old_sections), section_keys(new_sections),
+             [&](const diff_key_t *old_key, const diff_key_t *new_key, uint32_t ordinal) {
+            if (report(diff_scope_t::section, old_key, new_key, ordinal)) {
+                account(old_sections, old_key, -1);
+                account(new_sections, new_key, 1);
+            }
+        });
+    }
+
+    if (options.segments) {
+        join(segment_keys(old_elf.get_segments()), segment_keys(new_elf.get_segments()),
+             [&](const diff_key_t *old_key, const diff_key_t *new_key, uint32_t ordinal) {
+            report(diff_scope_t::segment, old_key, new_key, ordinal);
+        });
+    }
+
+    // key both files' tables together so the chunks of all four share the
+    // pool; symbols() validates each table here, outside the workers
+    table_keys_t tables[2][2];      // [symtab, dynsym][old, new]
+    std::vector<table_keys_t*> wanted;
+    const Elf_parser *elfs[2] = {&old_elf, &new_elf};
+    for (int kind = 0; kind < 2; ++kind) {
+        if (!(kind ? options.dynamic : options.symbols))
+            continue;
+        for (int side = 0; side < 2; ++side) {
+            auto &found = elfs[side]->find_sections(kind ? SHT_DYNSYM : SHT_SYMTAB);
+            if (found.empty())
+                continue;
+            tables[kind][side].view = elfs[side]->symbols(found.front());
+            tables[kind][side].exports_only = (kind == 1);
+            wanted.push_back(&tables[kind][side]);
+        }
+    }
+    build_keys(wanted, options);
+
+    if (options.symbols) {
+        join(tables[0][0].keys, tables[0][1].keys,
+             [&](const diff_key_t *old_key, const diff_key_t *new_key, uint32_t ordinal) {
+            if (!report(diff_scope_t::symbol, old_key, new_key, ordinal))
+                return;
+            if (new_key)
+                summary.symbol_bytes += (int64_t)new_key->size;
+            if (old_key)
+                summary.symbol_bytes -= (int64_t)old_key->size;
+        });
+    }
+    if (options.dynamic) {
+        join(tables[1][0].keys, tables[1][1].keys,
+             [&](const diff_key_t *old_key, const diff_key_t *new_key, uint32_t ordinal) {
+            report(diff_scope_t::dynamic, old_key, new_key, ordinal);
+        });
+    }
+    return summary;
+}
+
+static void append_json_string(std::string &out, std::string_view s) {
+    out += '"';
+    for (unsigned char c : s) {
+        if ((c == '"') || (c == '\\')) {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// "RWE" for segments, readelf's "FUNC GLOBAL DEFAULT" for symbols
+static std::string flags_string(diff_scope_t scope, uint32_t flags) {
+    if (scope == diff_scope_t::segment) {
+        std::string out;
+        if (flags & PF_R)
+            out += 'R';
+        if (flags & PF_W)
+            out += 'W';
+        if (flags & PF_X)
+            out += 'E';
+        return out;
+    }
+    static const char *types[] = {"NOTYPE", "OBJECT", "FUNC", "SECTION", "FILE", "COMMON", "TLS"};
+    static const char *binds[] = {"LOCAL", "GLOBAL", "WEAK"};
+    static const char *visibilities[] = {"DEFAULT", "INTERNAL", "HIDDEN", "PROTECTED"};
+    unsigned type = ELF64_ST_TYPE(flags), bind = ELF64_ST_BIND(flags);
+    std::string out;
+    if (type < 7)
+        out = types[type];
+    else if (type == STT_GNU_IFUNC)
+        out = "IFUNC";
+    else
+        out = std::to_string(type);
+    out += ' ';
+    if (bind < 3)
+        out += binds[bind];
+    else if (bind == STB_GNU_UNIQUE)
+        out += "UNIQUE";
+    else
+        out += std::to_string(bind);
+    out += ' ';
+    out += visibilities[ELF64_ST_VISIBILITY(flags >> 8)];
+    return out;
+}
+
+std::string elf_parser::to_json(const diff_entry_t &entry) {
+    static const char *scopes[] = {"section", "segment", "symbol", "dynamic"};
+    static const char *changes[] = {"added", "removed", "resized", "changed"};
+    bool has_old = (entry.change != diff_change_t::added);
+    bool has_new = (entry.change != diff_change_t::removed);
+    bool has_flags = (entry.scope != diff_scope_t::section);
+
+    std::string out = "{\"scope\":\"";
+    out += scopes[(int)entry.scope];
+    out += "\",\"change\":\"";
+    out += changes[(int)entry.change];
+    out += "\",\"name\":";
+    append_json_string(out, entry.name);
+    if (entry.ordinal)
+        out += ",\"ordinal\":" + std::to_string(entry.ordinal);
+    if (has_old)
+        out += ",\"old_size\":" + std::to_string(entry.old_size);
+    if (has_new)
+        out += ",\"new_size\":" + std::to_string(entry.new_size);
+    if (has_flags && has_old)
+        out += ",\"old_flags\":\"" + flags_string(entry.scope, entry.old_flags) + '"';
+    if (has_flags && has_new)
+        out += ",\"new_flags\":\"" + flags_string(entry.scope, entry.new_flags) + '"';
+    out += '}';
+    return out;
+}
+
+std::string elf_parser::to_json(const diff_summary_t &summary) {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+        "{\"added\":%zu,\"removed\":%zu,\"resized\":%zu,\"changed\":%zu,"
+        "\"file_bytes\":%" PRId64 ",\"alloc_bytes\":%" PRId64 ",\"symbol_bytes\":%" PRId64 "}",
+        summary.added, summary.removed, summary.resized, summary.changed,
+        summary.file_bytes, summary.alloc_bytes, summary.symbol_bytes);
+    return buf;
+}
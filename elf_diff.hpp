@@ -0,0 +1,89 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_ELF_DIFF
+#define H_ELF_DIFF
+
+#include "elf_parser.hpp"
+
+namespace elf_parser {
+
+/* what a diff entry describes */
+enum class diff_scope_t : uint8_t {
+    section,        // by name
+    segment,        // by type and position among segments of that type
+    symbol,         // .symtab entries other than SECTION and FILE
+    dynamic,        // defined .dynsym entries with default or protected visibility
+};
+
+enum class diff_change_t : uint8_t {
+    added, removed,
+    resized,        // sh_size, p_memsz or st_size changed
+    changed,        // p_flags, or symbol type, bind or visibility changed
+};
+
+/* One difference between two files. name points into one of the parsers
+ * and is only valid during the sink call that receives the entry. */
+typedef struct {
+    diff_scope_t scope;
+    diff_change_t change;
+    std::string_view name;              // segments: the type, e.g. "LOAD"
+    /* segments: position among those of the same type; symbols: position
+     * among those of the same name, in table order */
+    uint32_t ordinal = 0;
+    uint64_t old_size = 0, new_size = 0;
+    /* segments: p_flags; symbols: st_info | st_other << 8 */
+    uint32_t old_flags = 0, new_flags = 0;
+} diff_entry_t;
+
+typedef struct {
+    size_t added = 0, removed = 0, resized = 0, changed = 0;
+    int64_t file_bytes = 0;     // growth of sections stored in the file
+    int64_t alloc_bytes = 0;    // growth of SHF_ALLOC sections, .bss included
+    int64_t symbol_bytes = 0;   // growth of .symtab symbol sizes
+} diff_summary_t;
+
+typedef std::function<void(const diff_entry_t &entry)> diff_sink_t;
+
+typedef struct {
+    bool sections = true, segments = true, symbols = true, dynamic = true;
+    /* symbol tables are keyed and sorted in chunks through parallel_for,
+     * when set; tables below the threshold stay one chunk */
+    parallel_for_t parallel_for;
+    size_t parallel_threshold = 1 << 16;
+} diff_options_t;
+
+/* Structural difference from old_elf to new_elf, reported entry by entry
+ * to sink, in scope order. Each side's sections and symbol tables are
+ * keyed once and sorted, then merge-joined; symbols are compared through
+ * compact keys pointing into the mapped string tables, never symbol_t.
+ * Symbols come in name-hash order, which is stable across runs. Throws
+ * Elf_error when a symbol table fails validation. */
+diff_summary_t diff(const Elf_parser &old_elf, const Elf_parser &new_elf,
+                    const diff_sink_t &sink, const diff_options_t &options = diff_options_t());
+
+/* one-line JSON renderings, for a JSON-lines report */
+std::string to_json(const diff_entry_t &entry);
+std::string to_json(const diff_summary_t &summary);
+
+}
+#endif
@@ -0,0 +1,379 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "elf_index.hpp"
+using namespace elf_parser;
+
+static const char index_magic[8] = {'E', 'L', 'F', 'I', 'D', 'X', '\0', '\0'};
+static const uint32_t index_version = 1;
+static const uint32_t index_byte_order = 0x01020304;
+
+struct ElfIndex::index_header_t {
+    char magic[8];
+    uint32_t version, byte_order;
+    uint64_t file_size;
+    uint64_t checksum;          // over everything after the header
+    uint32_t key_size, nsections, nsymbols, nbuckets;
+    uint64_t key_off, sections_off, addrs_off, symbols_off, buckets_off;
+    uint64_t strings_off, strings_size;
+};
+
+struct ElfIndex::index_symbol_t {
+    uint64_t end;
+    uint32_t name_off, name_size;
+    uint32_t parent;            // SymbolResolver::npos when there is none
+    uint32_t reserved;
+};
+
+typedef struct {
+    uint64_t flags, addr, offset, size;
+    uint32_t name_off, name_size, type, reserved;
+} index_section_rec_t;
+
+// four independent multiply-xor lanes so the loop is not latency bound;
+// catches truncation and bit rot, not tampering
+static uint64_t checksum(const uint8_t *data, size_t size) {
+    const uint64_t prime = 0x100000001b3ull;
+    uint64_t lanes[4] = {0xcbf29ce484222325ull, 0x9e3779b97f4a7c15ull,
+                         0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int k = 0; k < 4; ++k) {
+            uint64_t word;
+            memcpy(&word, data + i + 8 * k, 8);
+            lanes[k] = (lanes[k] ^ word) * prime;
+        }
+    }
+    for (; i < size; ++i)
+        lanes[i & 3] = (lanes[i & 3] ^ data[i]) * prime;
+
+    uint64_t h = size;
+    for (auto lane : lanes)
+        h = (h ^ lane ^ (lane >> 29)) * prime;
+    return h;
+}
+
+static uint32_t name_hash(std::string_view name) {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : name)
+        h = (h ^ c) * 16777619u;
+    return h;
+}
+
+template <typename T>
+static uint64_t append_block(std::vector<uint8_t> &out, const T *data, size_t count) {
+    out.resize((out.size() + 7) & ~(size_t)7, 0);
+    uint64_t offset = out.size();
+    out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)(data + count));
+    return offset;
+}
+
+void ElfIndex::write(const Elf_parser &elf, std::string_view key, const std::string &path) {
+    std::vector<char> strings;
+    auto add_string = [&strings](std::string_view s) {
+        uint32_t offset = strings.size();
+        strings.insert(strings.end(), s.begin(), s.end());
+        return offset;
+    };
+
+    std::vector<index_section_rec_t> sections;
+    for (auto sec : elf.sections()) {
+        auto *shdr = sec.header;
+        sections.push_back({shdr->sh_flags, shdr->sh_addr, shdr->sh_offset, shdr->sh_size,
+                            add_string(sec.name), (uint32_t)sec.name.size(), shdr->sh_type, 0});
+    }
+
+    SymbolResolver resolver(elf);
+    auto &entries = resolver.entries();
+    std::vector<uint64_t> addrs;
+    std::vector<index_symbol_t> symbols;
+    addrs.reserve(entries.size());
+    symbols.reserve(entries.size());
+    for (auto &entry : entries) {
+        addrs.push_back(entry.addr);
+        symbols.push_back({entry.end, add_string(entry.name), (uint32_t)entry.name.size(),
+                           entry.parent, 0});
+    }
+
+    // open addressing at <= 50% load; slots hold symbol index + 1
+    uint32_t nbuckets = 0;
+    if (!symbols.empty()) {
+        nbuckets = 1;
+        while (nbuckets < 2 * symbols.size())
+            nbuckets <<= 1;
+    }
+    std::vector<uint32_t> buckets(nbuckets, 0);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        uint32_t slot = name_hash(entries[i].name) & (nbuckets - 1);
+        while (buckets[slot])
+            slot = (slot + 1) & (nbuckets - 1);
+        buckets[slot] = i + 1;
+    }
+
+    index_header_t header = {};
+    memcpy(header.magic, index_magic, sizeof(index_magic));
+    header.version = index_version;
+    header.byte_order = index_byte_order;
+    header.key_size = key.size();
+    header.nsections = sections.size();
+    header.nsymbols = symbols.size();
+    header.nbuckets = nbuckets;
+
+    std::vector<uint8_t> out(sizeof(header), 0);
+    header.key_off = append_block(out, key.data(), key.size());
+    header.sections_off = append_block(out, sections.data(), sections.size());
+    header.addrs_off = append_block(out, addrs.data(), addrs.size());
+    header.symbols_off = append_block(out, symbols.data(), symbols.size());
+    header.buckets_off = append_block(out, buckets.data(), buckets.size());
+    header.strings_off = append_block(out, strings.data(), strings.size());
+    header.strings_size = strings.size();
+    header.file_size = out.size();
+    header.checksum = checksum(out.data() + sizeof(header), out.size() - sizeof(header));
+    memcpy(out.data(), &header, sizeof(header));
+
+    // readers never see a partial file: write aside, then rename over
+    // mkostemp names the file per writer, so concurrent rebuilds of one key
+    // in any thread or process never share it
+    std::string tmp = path + ".tmp.XXXXXX";
+    int fd = mkostemp(tmp.data(), O_CLOEXEC);
+    if (fd < 0)
+        throw Elf_error("Err: open " + tmp, Elf_errc::io);
+    fchmod(fd, 0644);
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t n = ::write(fd, out.data() + done, out.size() - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            close(fd);
+            unlink(tmp.c_str());
+            throw Elf_error("Err: write " + tmp, Elf_errc::io);
+        }
+        done += n;
+    }
+    close(fd);
+    if (rename(tmp.c_str(), path.c_str()) < 0) {
+        unlink(tmp.c_str());
+        throw Elf_error("Err: rename " + path, Elf_errc::io);
+    }
+}
+
+ElfIndex::ElfIndex(const std::string &path, std::string_view key) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw Elf_error("Err: open " + path, Elf_errc::io);
+
+    struct stat st;
+    if ((fstat(fd, &st) < 0) || ((size_t)st.st_size < sizeof(index_header_t))) {
+        close(fd);
+        throw Elf_error("Corrupt index: " + path);
+    }
+    m_size = st.st_size;
+    void *map = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        throw Elf_error("Err: mmap " + path, Elf_errc::io);
+    m_map = (uint8_t*)map;
+    m_header = (const index_header_t*)m_map;
+
+    auto &h = *m_header;
+    auto fits = [this](uint64_t offset, uint64_t count, uint64_t size) {
+        return !(offset & 7) && (offset <= m_size) && (count <= (m_size - offset) / size);
+    };
+    const char *error = nullptr;
+    if (memcmp(h.magic, index_magic, sizeof(index_magic)) || (h.byte_order != index_byte_order))
+        error = "Not an index file: ";
+    else if (h.version != index_version)
+        error = "Stale index version: ";
+    else if ((h.file_size != m_size) || !fits(h.key_off, h.key_size, 1) ||
+             !fits(h.sections_off, h.nsections, sizeof(index_section_rec_t)) ||
+             !fits(h.addrs_off, h.nsymbols, sizeof(uint64_t)) ||
+             !fits(h.symbols_off, h.nsymbols, sizeof(index_symbol_t)) ||
+             !fits(h.buckets_off, h.nbuckets, sizeof(uint32_t)) ||
+             !fits(h.strings_off, h.strings_size, 1) ||
+             (h.nbuckets & (h.nbuckets - 1)) || (h.nsymbols && !h.nbuckets))
+        error = "Corrupt index: ";
+    else if (std::string_view((const char*)m_map + h.key_off, h.key_size) != key)
+        error = "Stale index: ";
+    else if (checksum(m_map + sizeof(h), m_size - sizeof(h)) != h.checksum)
+        error = "Corrupt index: ";
+
+    if (error) {
+        munmap(m_map, m_size);
+        throw Elf_error(error + path);
+    }
+}
+
+ElfIndex::ElfIndex(ElfIndex &&other) noexcept {
+    std::swap(m_map, other.m_map);
+    std::swap(m_size, other.m_size);
+    std::swap(m_header, other.m_header);
+}
+
+ElfIndex &ElfIndex::operator=(ElfIndex &&other) noexcept {
+    std::swap(m_map, other.m_map);
+    std::swap(m_size, other.m_size);
+    std::swap(m_header, other.m_header);
+    return *this;
+}
+
+ElfIndex::~ElfIndex() {
+    if (m_map)
+        munmap(m_map, m_size);
+}
+
+std::string_view ElfIndex::string(uint32_t offset, uint32_t size) const {
+    if ((uint64_t)offset + size > m_header->strings_size)
+        return std::string_view();
+    return std::string_view((const char*)m_map + m_header->strings_off + offset, size);
+}
+
+size_t ElfIndex::section_count() const {
+    return m_header->nsections;
+}
+
+index_section_t ElfIndex::section(size_t i) const {
+    auto *rec = (const index_section_rec_t*)(m_map + m_header->sections_off) + i;
+    return {string(rec->name_off, rec->name_size), rec->type,
+            rec->flags, rec->addr, rec->offset, rec->size};
+}
+
+size_t ElfIndex::symbol_count() const {
+    return m_header->nsymbols;
+}
+
+resolution_t ElfIndex::match(size_t i, uint64_t addr) const {
+    auto *addrs = (const uint64_t*)(m_map + m_header->addrs_off);
+    auto *syms = (const index_symbol_t*)(m_map + m_header->symbols_off);
+
+    resolution_t res;
+    while (i < m_header->nsymbols) {
+        auto &sym = syms[i];
+        if (addr < sym.end) {
+            res.found = true;
+            res.symbol_name = string(sym.name_off, sym.name_size);
+            res.symbol_addr = addrs[i];
+            res.symbol_size = (sym.end == UINT64_MAX) ? 0 : sym.end - addrs[i];
+            res.offset = addr - addrs[i];
+            break;
+        }
+        // parents always come earlier, which also bounds the walk
+        if ((sym.parent == SymbolResolver::npos) || (sym.parent >= i))
+            break;
+        i = sym.parent;
+    }
+    return res;
+}
+
+resolution_t ElfIndex::resolve(uint64_t addr) const {
+    auto *addrs = (const uint64_t*)(m_map + m_header->addrs_off);
+    auto *upper = std::upper_bound(addrs, addrs + m_header->nsymbols, addr);
+    if (upper == addrs)
+        return resolution_t();
+    return match(upper - addrs - 1, addr);
+}
+
+resolution_t ElfIndex::find(std::string_view name) const {
+    uint32_t mask = m_header->nbuckets - 1;
+    auto *buckets = (const uint32_t*)(m_map + m_header->buckets_off);
+    auto *addrs = (const uint64_t*)(m_map + m_header->addrs_off);
+    auto *syms = (const index_symbol_t*)(m_map + m_header->symbols_off);
+
+    resolution_t res;
+    if (!m_header->nbuckets)
+        return res;
+    uint32_t slot = name_hash(name) & mask;
+    for (uint32_t probes = 0; buckets[slot] && (probes <= mask); ++probes) {
+        uint32_t i = buckets[slot] - 1;
+        if ((i < m_header->nsymbols) && (string(syms[i].name_off, syms[i].name_size) == name)) {
+            res.found = true;
+            res.symbol_name = string(syms[i].name_off, syms[i].name_size);
+            res.symbol_addr = addrs[i];
+            res.symbol_size = (syms[i].end == UINT64_MAX) ? 0 : syms[i].end - addrs[i];
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return res;
+}
+
+IndexCache::IndexCache(std::string dir) : m_dir{std::move(dir)} {
+    if ((mkdir(m_dir.c_str(), 0755) < 0) && (errno != EEXIST))
+        throw Elf_error("Err: mkdir " + m_dir, Elf_errc::io);
+}
+
+std::string IndexCache::key_for(const std::string &path) {
+    static const char hex[] = "0123456789abcdef";
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw Elf_error("Err: open " + path, Elf_errc::io);
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        throw Elf_error("Err: stat " + path, Elf_errc::io);
+    }
+    // a file that is not ELF gets no build-id here and fails to parse later
+    fingerprint_t probe = fingerprint(fd);
+    close(fd);
+
+    // a stripped file and its unstripped twin share the build-id, the size
+    // tells them apart
+    if (!probe.build_id.empty()) {
+        std::string key;
+        for (unsigned char c : probe.build_id) {
+            key += hex[c >> 4];
+            key += hex[c & 15];
+        }
+        return key + "-" + std::to_string(st.st_size);
+    }
+    return "f-" + std::to_string(st.st_size) + "-" +
+           std::to_string(st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec) + "-" +
+           std::to_string(st.st_dev) + "-" + std::to_string(st.st_ino);
+}
+
+ElfIndex IndexCache::open(const std::string &path) {
+    std::string key = key_for(path);
+    std::string file = m_dir + "/" + key + ".idx";
+
+    bool existed = access(file.c_str(), F_OK) == 0;
+    if (existed) {
+        try {
+            ElfIndex index(file, key);
+            ++m_hits;
+            return index;
+        } catch (const Elf_error &) {
+            // stale or corrupt: fall through and replace it
+        }
+    }
+
+    Elf_parser elf(path);
+    ElfIndex::write(elf, key, file);
+    ++m_builds;
+    if (existed)
+        ++m_rebuilds;
+    return ElfIndex(file, key);
+}
@@ -0,0 +1,108 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_ELF_INDEX
+#define H_ELF_INDEX
+
+#include "fingerprint.hpp"
+#include "symbol_resolver.hpp"
+
+namespace elf_parser {
+
+/* one section table entry as stored in an index file */
+typedef struct {
+    std::string_view name;
+    uint32_t type;
+    uint64_t flags, addr, offset, size;
+} index_section_t;
+
+/* Read-only view of an on-disk index: the section table, the resolver's
+ * address-sorted symbol ranges and an open-addressing hash over their names.
+ * Everything inside the file is addressed by offset, so it is valid wherever
+ * it gets mapped, and queries run straight off the mapping.
+ *
+ * Layout: index_header_t, key bytes, sections, symbol start addresses,
+ * symbol records, hash buckets, string pool. Each block is 8-byte aligned. */
+class ElfIndex {
+    public:
+        /* serialize the index for elf, tagged with key, and write it to
+         * path through a temporary file and rename(); throws Elf_error */
+        static void write(const Elf_parser &elf, std::string_view key, const std::string &path);
+
+        /* map an index file; throws Elf_error when it is missing, was written
+         * for another key or version, or fails the bounds and checksum checks */
+        ElfIndex(const std::string &path, std::string_view key);
+
+        ElfIndex(ElfIndex &&other) noexcept;
+        ElfIndex &operator=(ElfIndex &&other) noexcept;
+        ElfIndex(const ElfIndex &) = delete;
+        ElfIndex &operator=(const ElfIndex &) = delete;
+        ~ElfIndex();
+
+        size_t section_count() const;
+        index_section_t section(size_t i) const;
+        size_t symbol_count() const;
+
+        /* same answers as SymbolResolver::resolve() on the indexed file */
+        resolution_t resolve(uint64_t addr) const;
+        /* the indexed symbol range carrying name; offset is always 0 */
+        resolution_t find(std::string_view name) const;
+
+    private:
+        struct index_header_t;
+        struct index_symbol_t;
+
+        std::string_view string(uint32_t offset, uint32_t size) const;
+        resolution_t match(size_t i, uint64_t addr) const;
+
+        uint8_t *m_map = nullptr;
+        size_t m_size = 0;
+        const index_header_t *m_header = nullptr;
+};
+
+/* Directory of index files keyed by NT_GNU_BUILD_ID, or by size, mtime and
+ * inode for files without one. open() computes the key from stat() and the
+ * PT_NOTE build-id alone, maps the cached index when it is present and valid,
+ * and parses the ELF file only to (re)build it. open() may be called from
+ * several threads at once; each rebuild writes its own temporary file. */
+class IndexCache {
+    public:
+        explicit IndexCache(std::string dir);
+
+        ElfIndex open(const std::string &path);
+
+        /* cache key for the file at path, as used for the index file name;
+         * reads the headers and notes only, as fingerprint() does */
+        static std::string key_for(const std::string &path);
+
+        size_t hits() const { return m_hits; }
+        size_t builds() const { return m_builds; }
+        /* builds that replaced a stale or corrupt index file */
+        size_t rebuilds() const { return m_rebuilds; }
+
+    private:
+        std::string m_dir;
+        std::atomic<size_t> m_hits{0}, m_builds{0}, m_rebuilds{0};
+};
+
+}
+#endif
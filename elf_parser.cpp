@@ -20,192 +20,1615 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <atomic>
+#include <list>
+#include <cerrno>
+#include <algorithm>
+#include <chrono>
 #include "elf_parser.hpp"
 using namespace elf_parser;
 
-std::vector<section_t> Elf_parser::get_sections() {
-    Elf64_Ehdr *ehdr = (Elf64_Ehdr*)m_mmap_program;
-    Elf64_Shdr *shdr = (Elf64_Shdr*)(m_mmap_program + ehdr->e_shoff);
-    int shnum = ehdr->e_shnum;
-
-    Elf64_Shdr *sh_strtab = &shdr[ehdr->e_shstrndx];
-    const char *const sh_strtab_p = (char*)m_mmap_program + sh_strtab->sh_offset;
-
-    std::vector<section_t> sections;
-    for (int i = 0; i < shnum; ++i) {
-        section_t section;
-        section.section_index= i;
-        section.section_name = std::string(sh_strtab_p + shdr[i].sh_name);
-        section.section_type = get_section_type(shdr[i].sh_type);
-        section.section_addr = shdr[i].sh_addr;
-        section.section_offset = shdr[i].sh_offset;
-        section.section_size = shdr[i].sh_size;
-        section.section_ent_size = shdr[i].sh_entsize;
-        section.section_addr_align = shdr[i].sh_addralign; 
-        
-        sections.push_back(section);
-    }
-    return sections;
-}
-
-std::vector<segment_t> Elf_parser::get_segments() {
-    Elf64_Ehdr *ehdr = (Elf64_Ehdr*)m_mmap_program;
-    Elf64_Phdr *phdr = (Elf64_Phdr*)(m_mmap_program + ehdr->e_phoff);
-    int phnum = ehdr->e_phnum;
-
-    Elf64_Shdr *shdr = (Elf64_Shdr*)(m_mmap_program + ehdr->e_shoff);
-    Elf64_Shdr *sh_strtab = &shdr[ehdr->e_shstrndx];
-    const char *const sh_strtab_p = (char*)m_mmap_program + sh_strtab->sh_offset;
-
-    std::vector<segment_t> segments;
-    for (int i = 0; i < phnum; ++i) {
-        segment_t segment;
-        segment.segment_type     = get_segment_type(phdr[i].p_type);
-        segment.segment_offset   = phdr[i].p_offset;
-        segment.segment_virtaddr = phdr[i].p_vaddr;
-        segment.segment_physaddr = phdr[i].p_paddr;
-        segment.segment_filesize = phdr[i].p_filesz;
-        segment.segment_memsize  = phdr[i].p_memsz;
-        segment.segment_flags    = get_segment_flags(phdr[i].p_flags);
-        segment.segment_align    = phdr[i].p_align;
-        
-        segments.push_back(segment);
-    }
-    return segments;
+#ifdef ELF_PARSER_STATS
+namespace {
+// adds the lifetime of the enclosing scope to a phase counter
+class Stats_timer {
+    public:
+        explicit Stats_timer(std::atomic<uint64_t> &total)
+            : m_total{total}, m_start{std::chrono::steady_clock::now()} {}
+        ~Stats_timer() {
+            m_total += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_start).count();
+        }
+    private:
+        std::atomic<uint64_t> &m_total;
+        std::chrono::steady_clock::time_point m_start;
+};
+
+// strings past the libstdc++ small-string buffer live on the heap
+unsigned heap_strings(std::initializer_list<const std::string*> strings) {
+    unsigned n = 0;
+    for (auto s : strings)
+        n += s->size() > 15;
+    return n;
 }
+}
+#define ELF_STATS_TIMER(phase) Stats_timer stats_timer_(m_cache->stats.phase)
+#define ELF_STATS_ADD(counter, n) (m_cache->stats.counter += (n))
+#else
+#define ELF_STATS_TIMER(phase) do {} while (0)
+#define ELF_STATS_ADD(counter, n) do {} while (0)
+#endif
 
-std::vector<symbol_t> Elf_parser::get_symbols() {
-    std::vector<section_t> secs = get_sections();
+/* pread-backed file access for streaming mode. Section buffers are kept in
+ * an LRU bounded by a byte budget; evicted buffers stay alive for as long
+ * as a view still holds them. */
+class elf_parser::Pread_reader {
+    public:
+        typedef std::shared_ptr<const std::vector<uint8_t>> buffer_t;
 
-    // get headers for offsets
-    Elf64_Ehdr *ehdr = (Elf64_Ehdr*)m_mmap_program;
-    Elf64_Shdr *shdr = (Elf64_Shdr*)(m_mmap_program + ehdr->e_shoff);
+        Pread_reader(int fd, uint64_t file_size, size_t budget)
+            : m_fd{fd}, m_file_size{file_size}, m_budget{budget} {}
+        ~Pread_reader() { close(m_fd); }
 
-    // get strtab
-    char *sh_strtab_p = nullptr;
-    for(auto &sec: secs) {
-        if((sec.section_type == "SHT_STRTAB") && (sec.section_name == ".strtab")){
-            sh_strtab_p = (char*)m_mmap_program + sec.section_offset;
-            break;
-        }
-    }
+        buffer_t read(uint64_t offset, uint64_t size, bool cache = true) {
+            auto key = std::make_pair(offset, size);
+            if (cache) {
+                std::lock_guard<std::mutex> guard(m_lock);
+                auto it = m_index.find(key);
+                if (it != m_index.end()) {
+                    m_lru.splice(m_lru.begin(), m_lru, it->second);
+                    return it->second->second;
+                }
+            }
 
-    // get dynstr
-    char *sh_dynstr_p = nullptr;
-    for(auto &sec: secs) {
-        if((sec.section_type == "SHT_STRTAB") && (sec.section_name == ".dynstr")){
-            sh_dynstr_p = (char*)m_mmap_program + sec.section_offset;
-            break;
+            // one spare NUL so an unterminated string table stays bounded
+            auto buf = std::make_shared<std::vector<uint8_t>>(size + 1, 0);
+            uint64_t avail = (offset < m_file_size) ? std::min(size, m_file_size - offset) : 0;
+            for (uint64_t done = 0; done < avail; ) {
+                ssize_t n = pread(m_fd, buf->data() + done, avail - done, offset + done);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    throw Elf_error("Err: pread", Elf_errc::io);
+                done += n;
+            }
+            m_bytes_read += avail;
+
+            if (cache) {
+                std::lock_guard<std::mutex> guard(m_lock);
+                if (m_index.find(key) == m_index.end()) {
+                    m_lru.emplace_front(key, buf);
+                    m_index[key] = m_lru.begin();
+                    m_cached += size;
+                    while ((m_cached > m_budget) && (m_lru.size() > 1)) {
+                        m_cached -= m_lru.back().first.second;
+                        m_index.erase(m_lru.back().first);
+                        m_lru.pop_back();
+                    }
+                }
+            }
+            return buf;
         }
-    }
 
-    std::vector<symbol_t> symbols;
-    for(auto &sec: secs) {
-        if((sec.section_type != "SHT_SYMTAB") && (sec.section_type != "SHT_DYNSYM"))
-            continue;
+        uint64_t bytes_read() const { return m_bytes_read; }
 
-        auto total_syms = sec.section_size / sizeof(Elf64_Sym);
-        auto syms_data = (Elf64_Sym*)(m_mmap_program + sec.section_offset);
-
-        for (int i = 0; i < total_syms; ++i) {
-            symbol_t symbol;
-            symbol.symbol_num       = i;
-            symbol.symbol_value     = syms_data[i].st_value;
-            symbol.symbol_size      = syms_data[i].st_size;
-            symbol.symbol_type      = get_symbol_type(syms_data[i].st_info);
-            symbol.symbol_bind      = get_symbol_bind(syms_data[i].st_info);
-            symbol.symbol_visibility= get_symbol_visibility(syms_data[i].st_other);
-            symbol.symbol_index     = get_symbol_index(syms_data[i].st_shndx);
-            symbol.symbol_section   = sec.section_name;
-            
-            if(sec.section_type == "SHT_SYMTAB")
-                symbol.symbol_name = std::string(sh_strtab_p + syms_data[i].st_name);
+    private:
+        typedef std::pair<uint64_t, uint64_t> key_t;
+        struct key_hash {
+            size_t operator()(const key_t &k) const {
+                return std::hash<uint64_t>()(k.first) ^ (std::hash<uint64_t>()(k.second) << 1);
+            }
+        };
+
+        int m_fd;
+        uint64_t m_file_size;
+        size_t m_budget, m_cached = 0;
+        std::atomic<uint64_t> m_bytes_read{0};
+
+        std::mutex m_lock;
+        std::list<std::pair<key_t, buffer_t>> m_lru;     // most recent first
+        std::unordered_map<key_t, std::list<std::pair<key_t, buffer_t>>::iterator, key_hash> m_index;
+};
+
+const std::vector<section_t> &Elf_parser::get_sections() const {
+    std::call_once(m_cache->sections_once, [this] {
+        auto secs = this->sections();
+        auto &sections = m_cache->sections;
+        sections.reserve(secs.size());
+        ELF_STATS_ADD(entries_decoded, secs.size());
+        ELF_STATS_ADD(allocations, 1);
+
+        for (auto sec : secs) {
+            section_t section;
+            section.section_index= sec.index;
+            section.section_name = std::string(sec.name);
+            section.section_type = get_section_type(sec.header->sh_type);
+            section.section_addr = sec.header->sh_addr;
+            section.section_offset = sec.header->sh_offset;
+            section.section_size = sec.header->sh_size;
+            section.section_ent_size = sec.header->sh_entsize;
+            section.section_addr_align = sec.header->sh_addralign; 
+            if (auto chdr = get_compression_header(sec)) {
+                section.section_size = chdr->ch_size;
+                section.section_compressed_size = sec.header->sh_size;
+            }
+            ELF_STATS_ADD(allocations, heap_strings({&section.section_name, &section.section_type}));
             
-            if(sec.section_type == "SHT_DYNSYM")
-                symbol.symbol_name = std::string(sh_dynstr_p + syms_data[i].st_name);
+            sections.push_back(section);
+        }
+    });
+    return m_cache->sections;
+}
+
+const std::vector<segment_t> &Elf_parser::get_segments() const {
+    std::call_once(m_cache->segments_once, [this] {
+        const Elf64_Phdr *phdr = m_phdr;
+        int phnum = m_ehdr->e_phnum;
+
+        auto &segments = m_cache->segments;
+        segments.reserve(phnum);
+        ELF_STATS_ADD(entries_decoded, phnum);
+        ELF_STATS_ADD(allocations, 1);
+        for (int i = 0; i < phnum; ++i) {
+            segment_t segment;
+            segment.segment_type     = get_segment_type(phdr[i].p_type);
+            segment.segment_offset   = phdr[i].p_offset;
+            segment.segment_virtaddr = phdr[i].p_vaddr;
+            segment.segment_physaddr = phdr[i].p_paddr;
+            segment.segment_filesize = phdr[i].p_filesz;
+            segment.segment_memsize  = phdr[i].p_memsz;
+            segment.segment_flags    = get_segment_flags(phdr[i].p_flags);
+            segment.segment_align    = phdr[i].p_align;
             
-            symbols.push_back(symbol);
+            segments.push_back(segment);
         }
-    }
-    return symbols;
+    });
+    return m_cache->segments;
 }
 
-std::vector<relocation_t> Elf_parser::get_relocations() {
-    auto secs = get_sections();
-    auto syms = get_symbols();
-    
-    int  plt_entry_size = 0;
-    long plt_vma_address = 0;
+const std::vector<symbol_t> &Elf_parser::get_symbols() const {
+    // symbols of one table decoded per parallel chunk
+    static const size_t chunk_size = 16384;
 
-    for (auto &sec : secs) {
-        if(sec.section_name == ".plt") {
-          plt_entry_size = sec.section_ent_size;
-          plt_vma_address = sec.section_addr;
-          break;
+    std::call_once(m_cache->symbols_once, [this] {
+        ELF_STATS_TIMER(symbol_decode_ns);
+        auto &symbols = m_cache->symbols;
+        for (auto sec : sections()) {
+            if((sec.header->sh_type != SHT_SYMTAB) && (sec.header->sh_type != SHT_DYNSYM))
+                continue;
+
+            auto syms = this->symbols(sec);
+            size_t base = symbols.size();
+            symbols.resize(base + syms.size());
+            ELF_STATS_ADD(entries_decoded, syms.size());
+            ELF_STATS_ADD(allocations, 1);
+
+            if (m_parallel_for && (syms.size() >= m_parallel_threshold)) {
+                size_t nchunks = (syms.size() + chunk_size - 1) / chunk_size;
+                m_parallel_for(nchunks, [&](size_t chunk) {
+                    size_t end = std::min(syms.size(), (chunk + 1) * chunk_size);
+                    for (size_t i = chunk * chunk_size; i < end; ++i)
+                        decode_symbol(syms[i], symbols[base + i]);
+                });
+                continue;
+            }
+
+            for (size_t i = 0; i < syms.size(); ++i)
+                decode_symbol(syms[i], symbols[base + i]);
         }
-    }
+    });
+    return m_cache->symbols;
+}
 
-    std::vector<relocation_t> relocations;
-    for (auto &sec : secs) {
+void Elf_parser::decode_symbol(const symbol_ref_t &sym, symbol_t &symbol) const {
+    symbol.symbol_num       = sym.num;
+    symbol.symbol_value     = sym.sym->st_value;
+    symbol.symbol_size      = sym.sym->st_size;
+    symbol.symbol_type      = get_symbol_type(sym.sym->st_info);
+    symbol.symbol_bind      = get_symbol_bind(sym.sym->st_info);
+    symbol.symbol_visibility= get_symbol_visibility(sym.sym->st_other);
+    symbol.symbol_index     = get_symbol_index(sym.sym->st_shndx);
+    symbol.symbol_section   = std::string(sym.section);
+    symbol.symbol_name      = std::string(sym.name);
+    ELF_STATS_ADD(allocations, heap_strings({&symbol.symbol_section, &symbol.symbol_name}));
+}
 
-        if(sec.section_type != "SHT_RELA") 
-            continue;
+bool Elf_parser::stats_enabled() {
+#ifdef ELF_PARSER_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+parse_stats_t Elf_parser::get_stats() const {
+    parse_stats_t stats;
+    if (!m_cache)
+        return stats;
+
+    auto &counters = m_cache->stats;
+    stats.map_ns           = counters.map_ns;
+    stats.header_ns        = counters.header_ns;
+    stats.strtab_ns        = counters.strtab_ns;
+    stats.symbol_decode_ns = counters.symbol_decode_ns;
+    stats.relocation_ns    = counters.relocation_ns;
+    stats.bytes_touched    = counters.bytes_touched;
+    stats.entries_decoded  = counters.entries_decoded;
+    stats.allocations      = counters.allocations;
+    stats.symbol_lookups   = counters.symbol_lookups;
+    return stats;
+}
+
+std::string Elf_parser::get_stats_json() const {
+    auto stats = get_stats();
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+        "{\"enabled\": %s, \"map_ns\": %lu, \"header_ns\": %lu, \"strtab_ns\": %lu, "
+        "\"symbol_decode_ns\": %lu, \"relocation_ns\": %lu, \"bytes_touched\": %lu, "
+        "\"entries_decoded\": %lu, \"allocations\": %lu, \"symbol_lookups\": %lu}",
+        stats_enabled() ? "true" : "false", stats.map_ns, stats.header_ns, stats.strtab_ns,
+        stats.symbol_decode_ns, stats.relocation_ns, stats.bytes_touched,
+        stats.entries_decoded, stats.allocations, stats.symbol_lookups);
+    return buf;
+}
+
+void Elf_parser::set_parallel_decode(parallel_for_t parallel_for, size_t threshold) {
+    m_parallel_for = std::move(parallel_for);
+    m_parallel_threshold = threshold;
+}
+
+// PLT stub layout per machine: bytes before the first stub, and stub size
+static void plt_layout(uint16_t machine, bool plt_sec, uint64_t entsize,
+                       uint64_t &header, uint64_t &stride) {
+    switch (machine) {
+        case EM_X86_64:
+        case EM_386:
+            // with IBT the callable stubs live in .plt.sec, without a header
+            header = plt_sec ? 0 : 16;
+            stride = 16;
+            break;
+        case EM_AARCH64:
+            header = 32;
+            stride = 16;
+            break;
+        default:
+            header = entsize;
+            stride = entsize;
+    }
+}
 
-        auto total_relas = sec.section_size / sizeof(Elf64_Rela);
-        auto relas_data  = (Elf64_Rela*)(m_mmap_program + sec.section_offset);
+static uint32_t relative_type(uint16_t machine) {
+    switch (machine) {
+        case EM_X86_64:  return R_X86_64_RELATIVE;
+        case EM_386:     return R_386_RELATIVE;
+        case EM_AARCH64: return R_AARCH64_RELATIVE;
+        default:         return 0;
+    }
+}
 
-        for (int i = 0; i < total_relas; ++i) {
+const std::vector<relocation_t> &Elf_parser::get_relocations() const {
+    std::call_once(m_cache->relocations_once, [this] {
+        ELF_STATS_TIMER(relocation_ns);
+        auto secs = sections();
+        
+        // only the DT_JMPREL entries have PLT slots, in table order
+        int jmprel_index = -1;
+        uint64_t plt_vma_address = 0, plt_header = 0, plt_stride = 0;
+        if (auto jmprel = plt_relocations()) {
+            auto plt = find_section(".plt.sec");
+            bool plt_sec = plt.has_value();
+            if (!plt_sec)
+                plt = find_section(".plt");
+            if (plt) {
+                jmprel_index = jmprel->index;
+                plt_vma_address = plt->header->sh_addr;
+                plt_layout(m_ehdr->e_machine, plt_sec, plt->header->sh_entsize,
+                           plt_header, plt_stride);
+            }
+        }
+
+        auto &relocations = m_cache->relocations;
+        auto add = [&](const section_ref_t &sec, const SymbolView &syms, int index,
+                       uint64_t offset, uint64_t r_info, int64_t addend) {
             relocation_t rel;
-            rel.relocation_offset = static_cast<std::intptr_t>(relas_data[i].r_offset);
-            rel.relocation_info   = static_cast<std::intptr_t>(relas_data[i].r_info);
+            rel.relocation_offset = static_cast<std::intptr_t>(offset);
+            rel.relocation_info   = static_cast<std::intptr_t>(r_info);
             rel.relocation_type   = \
-                get_relocation_type(relas_data[i].r_info);
+                get_relocation_type(r_info);
             
             rel.relocation_symbol_value = \
-                get_rel_symbol_value(relas_data[i].r_info, syms);
+                get_rel_symbol_value(r_info, syms);
             
             rel.relocation_symbol_name  = \
-                get_rel_symbol_name(relas_data[i].r_info, syms);
+                get_rel_symbol_name(r_info, syms);
             
-            rel.relocation_plt_address = plt_vma_address + (i + 1) * plt_entry_size;
-            rel.relocation_section_name = sec.section_name;
+            rel.relocation_plt_address = (sec.index == jmprel_index) ?
+                plt_vma_address + plt_header + index * plt_stride : 0;
+            rel.relocation_addend = addend;
+            rel.relocation_section_name = std::string(sec.name);
+            ELF_STATS_ADD(allocations, heap_strings({&rel.relocation_type,
+                &rel.relocation_symbol_name, &rel.relocation_section_name}));
             
-            relocations.push_back(rel);
+            relocations.push_back(std::move(rel));
+        };
+
+        for (auto sec : secs) {
+            uint32_t type = sec.header->sh_type;
+            if ((type != SHT_RELA) && (type != SHT_REL) && (type != SHT_RELR))
+                continue;
+
+            // a relocation resolves its symbol through its own sh_link
+            SymbolView syms;
+            if ((type != SHT_RELR) && (sec.header->sh_link < secs.size()))
+                syms = symbols(secs[sec.header->sh_link]);
+
+            if (type == SHT_RELA) {
+                auto relas = this->relocations(sec);
+                relocations.reserve(relocations.size() + relas.size());
+                ELF_STATS_ADD(entries_decoded, relas.size());
+                ELF_STATS_ADD(allocations, 1);
+                for (auto rela : relas)
+                    add(sec, syms, rela.index, rela.rela->r_offset, rela.rela->r_info, rela.rela->r_addend);
+            } else if (type == SHT_REL) {
+                auto rels = rel_relocations(sec);
+                relocations.reserve(relocations.size() + rels.size());
+                ELF_STATS_ADD(entries_decoded, rels.size());
+                ELF_STATS_ADD(allocations, 1);
+                for (auto rel : rels)
+                    add(sec, syms, rel.index, rel.rel->r_offset, rel.rel->r_info, 0);
+            } else {
+                std::vector<uint64_t> addrs(relr_count(sec));
+                addrs.resize(decode_relr(sec, addrs.data(), addrs.size()));
+                relocations.reserve(relocations.size() + addrs.size());
+                ELF_STATS_ADD(entries_decoded, addrs.size());
+                ELF_STATS_ADD(allocations, 2);
+                uint64_t r_info = ELF64_R_INFO(0, relative_type(m_ehdr->e_machine));
+                for (size_t i = 0; i < addrs.size(); ++i)
+                    add(sec, syms, i, addrs[i], r_info, 0);
+            }
+        }
+    });
+    return m_cache->relocations;
+}
+
+std::optional<uint64_t> Elf_parser::dynamic_value(int64_t tag) const {
+    for (auto &entry : get_dynamic_info().entries) {
+        if (entry.first == tag)
+            return entry.second;
+    }
+    return std::nullopt;
+}
+
+// file offset of [addr, addr + size), through the PT_LOAD segments
+std::optional<uint64_t> Elf_parser::vaddr_to_offset(uint64_t addr, uint64_t size) const {
+    for (int i = 0; i < m_ehdr->e_phnum; ++i) {
+        auto &phdr = m_phdr[i];
+        if ((phdr.p_type != PT_LOAD) || (addr < phdr.p_vaddr) ||
+                (addr - phdr.p_vaddr > phdr.p_filesz) || (size > phdr.p_filesz - (addr - phdr.p_vaddr)))
+            continue;
+        uint64_t offset = phdr.p_offset + (addr - phdr.p_vaddr);
+        if ((offset > m_program_size) || (size > m_program_size - offset))
+            return std::nullopt;
+        return offset;
+    }
+    return std::nullopt;
+}
+
+// the relocation table DT_JMPREL points at, else .rela.plt / .rel.plt
+std::optional<section_ref_t> Elf_parser::plt_relocations() const {
+    if (auto jmprel = dynamic_value(DT_JMPREL)) {
+        for (auto sec : sections()) {
+            uint32_t type = sec.header->sh_type;
+            if (((type == SHT_RELA) || (type == SHT_REL)) && (sec.header->sh_addr == *jmprel))
+                return sec;
         }
     }
-    return relocations;
+    if (auto sec = find_section(".rela.plt"))
+        return sec;
+    return find_section(".rel.plt");
+}
+
+size_t Elf_parser::relr_count(const section_ref_t &relsec) const {
+    std::shared_ptr<const void> keep;
+    uint64_t size;
+    auto relr = (const uint64_t*)table_bytes(relsec, size, keep);
+
+    // an even entry is an address, an odd one a bitmap of the next 63 words
+    size_t count = 0;
+    for (size_t i = 0; i < size / 8; ++i)
+        count += (relr[i] & 1) ? __builtin_popcountll(relr[i] >> 1) : 1;
+    return count;
+}
+
+size_t Elf_parser::decode_relr(const section_ref_t &relsec, uint64_t *out, size_t capacity) const {
+    std::shared_ptr<const void> keep;
+    uint64_t size;
+    auto relr = (const uint64_t*)table_bytes(relsec, size, keep);
+
+    size_t n = 0;
+    uint64_t where = 0;
+    for (size_t i = 0; (i < size / 8) && (n < capacity); ++i) {
+        uint64_t entry = relr[i];
+        if (!(entry & 1)) {
+            out[n++] = entry;
+            where = entry + 8;
+            continue;
+        }
+
+        // walk the set bits; the capacity check is hoisted out of the loop
+        // whenever a whole bitmap fits
+        uint64_t bits = entry >> 1;
+        if (n + 63 <= capacity) {
+            while (bits) {
+                out[n++] = where + 8 * __builtin_ctzll(bits);
+                bits &= bits - 1;
+            }
+        } else {
+            while (bits && (n < capacity)) {
+                out[n++] = where + 8 * __builtin_ctzll(bits);
+                bits &= bits - 1;
+            }
+        }
+        where += 63 * 8;
+    }
+    return n;
+}
+
+const uint8_t *Elf_parser::table_bytes(const section_ref_t &sec, uint64_t &size,
+                                       std::shared_ptr<const void> &keep) const {
+    if (((size_t)sec.index < m_tables.size()) && m_tables[sec.index].second) {
+        size = m_tables[sec.index].second;
+        return m_mmap_program + m_tables[sec.index].first;
+    }
+    if (sec.header->sh_type == SHT_NOBITS) {
+        size = 0;
+        return nullptr;
+    }
+    size = sec.header->sh_size;
+    return read_bytes(sec.header->sh_offset, size, keep);
+}
+
+void Elf_parser::build_section_index() const {
+    std::call_once(m_cache->index_once, [this] {
+        ELF_STATS_TIMER(strtab_ns);
+        for (auto sec : sections()) {
+            m_cache->by_name.emplace(sec.name, sec);
+            m_cache->by_type[sec.header->sh_type].push_back(sec);
+        }
+    });
+}
+
+std::optional<section_ref_t> Elf_parser::find_section(std::string_view name) const {
+    build_section_index();
+    auto it = m_cache->by_name.find(name);
+    if (it == m_cache->by_name.end())
+        return std::nullopt;
+    return it->second;
+}
+
+const std::vector<section_ref_t> &Elf_parser::find_sections(uint32_t sh_type) const {
+    static const std::vector<section_ref_t> none;
+
+    build_section_index();
+    auto it = m_cache->by_type.find(sh_type);
+    if (it == m_cache->by_type.end())
+        return none;
+    return it->second;
 }
 
 uint8_t *Elf_parser::get_memory_map() {
     return m_mmap_program;
 }
 
-void Elf_parser::load_memory_map() {
-    int fd, i;
-    struct stat st;
+uint64_t Elf_parser::get_bytes_read() const {
+    return m_reader ? m_reader->bytes_read() : 0;
+}
+
+SectionView Elf_parser::sections() const {
+    return SectionView((const uint8_t*)m_shdr, m_ehdr->e_shnum, sizeof(Elf64_Shdr), m_shstrtab, {});
+}
+
+SymbolView Elf_parser::symbols(const section_ref_t &symtab) const {
+    std::shared_ptr<const void> keep_base, keep_strtab;
+
+    // symbol names live in the string table the symtab links to
+    const char *strtab_p = nullptr;
+    uint64_t strtab_size = 0;
+    if ((symtab.header->sh_link < m_ehdr->e_shnum) &&
+            (m_shdr[symtab.header->sh_link].sh_type == SHT_STRTAB)) {
+        ELF_STATS_TIMER(strtab_ns);
+        auto &strtab = m_shdr[symtab.header->sh_link];
+        strtab_size = strtab.sh_size;
+        strtab_p = (const char*)read_bytes(strtab.sh_offset, strtab_size, keep_strtab);
+    }
+
+    uint64_t size;
+    auto base = table_bytes(symtab, size, keep_base);
+
+    // the string table's terminating NUL and each st_name are checked once
+    // per table, the first time it is viewed; entries are read unchecked
+    // from then on
+    bool known = (size_t)symtab.index < m_ehdr->e_shnum;
+    if (strtab_p && !(known && m_cache->names_checked[symtab.index].load(std::memory_order_acquire))) {
+        if (strtab_size && strtab_p[strtab_size - 1])
+            throw Elf_error("String table " + std::to_string(symtab.header->sh_link) +
+                            " not NUL terminated: " + m_program_path, Elf_errc::bad_string_table);
+        auto syms = (const Elf64_Sym*)base;
+        for (size_t i = 0; i < size / sizeof(Elf64_Sym); ++i) {
+            if (syms[i].st_name >= strtab_size)
+                throw Elf_error("Symbol name out of range in section " + std::to_string(symtab.index) +
+                                ": " + m_program_path, Elf_errc::bad_name);
+        }
+        if (known)
+            m_cache->names_checked[symtab.index].store(true, std::memory_order_release);
+    }
+    return SymbolView(base, size / sizeof(Elf64_Sym), sizeof(Elf64_Sym),
+                      strtab_p, symtab.name, symtab.index, keep_base, keep_strtab);
+}
+
+RelocationView Elf_parser::relocations(const section_ref_t &relsec) const {
+    std::shared_ptr<const void> keep_base;
+    uint64_t size;
+    auto base = table_bytes(relsec, size, keep_base);
+    return RelocationView(base, size / sizeof(Elf64_Rela), sizeof(Elf64_Rela),
+                          nullptr, relsec.name, relsec.index, keep_base);
+}
+
+RelView Elf_parser::rel_relocations(const section_ref_t &relsec) const {
+    std::shared_ptr<const void> keep_base;
+    uint64_t size;
+    auto base = table_bytes(relsec, size, keep_base);
+    return RelView(base, size / sizeof(Elf64_Rel), sizeof(Elf64_Rel),
+                   nullptr, relsec.name, relsec.index, keep_base);
+}
+
+const uint8_t *Elf_parser::read_bytes(uint64_t offset, uint64_t size,
+                                      std::shared_ptr<const void> &keep) const {
+    ELF_STATS_ADD(bytes_touched, size);
+    if (m_mmap_program)
+        return m_mmap_program + offset;
+
+    auto buf = m_reader->read(offset, size);
+    keep = buf;
+    return buf->data();
+}
+
+Elf_parser::Elf_parser(const std::string &program_path, const map_options_t &options)
+        : m_program_path{program_path}, m_cache{new cache_t} {
+    load_memory_map(options);
+}
+
+Elf_parser::Elf_parser(int fd, const map_options_t &options)
+        : m_program_path{"fd:" + std::to_string(fd)}, m_cache{new cache_t} {
+    if (options.stream) {
+        int dup_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (dup_fd < 0)
+            throw Elf_error("Err: dup " + m_program_path, Elf_errc::io);
+        open_stream(dup_fd, options);
+    } else {
+        map_fd(fd, options);
+    }
+    load_headers();
+}
+
+Elf_parser::Elf_parser(const uint8_t *data, size_t size)
+        : m_program_path{"<memory>"}, m_mmap_program{const_cast<uint8_t*>(data)},
+          m_program_size{size}, m_cache{new cache_t} {
+    load_headers();
+}
+
+Elf_parser::Elf_parser(Elf_parser &&other) noexcept {
+    swap(other);
+}
+
+Elf_parser &Elf_parser::operator=(Elf_parser &&other) noexcept {
+    if (this != &other) {
+        Elf_parser moved(std::move(other));
+        swap(moved);
+    }
+    return *this;
+}
+
+Elf_parser::~Elf_parser() {
+    release();
+}
+
+void Elf_parser::swap(Elf_parser &other) noexcept {
+    std::swap(m_program_path, other.m_program_path);
+    std::swap(m_mmap_program, other.m_mmap_program);
+    std::swap(m_program_size, other.m_program_size);
+    std::swap(m_owns_map, other.m_owns_map);
+    std::swap(m_reader, other.m_reader);
+    std::swap(m_image, other.m_image);
+    std::swap(m_tables, other.m_tables);
+    std::swap(m_class, other.m_class);
+    std::swap(m_data, other.m_data);
+    std::swap(m_ehdr, other.m_ehdr);
+    std::swap(m_phdr, other.m_phdr);
+    std::swap(m_shdr, other.m_shdr);
+    std::swap(m_shstrtab, other.m_shstrtab);
+    for (int i = 0; i < 4; ++i)
+        std::swap(m_keep_headers[i], other.m_keep_headers[i]);
+    std::swap(m_cache, other.m_cache);
+    std::swap(m_parallel_for, other.m_parallel_for);
+    std::swap(m_parallel_threshold, other.m_parallel_threshold);
+}
+
+void Elf_parser::release() {
+    if (m_owns_map && m_mmap_program)
+        munmap(m_mmap_program, m_program_size);
+    m_mmap_program = nullptr;
+    m_program_size = 0;
+    m_owns_map = false;
+    m_reader.reset();
+    m_image.clear();
+    m_image.shrink_to_fit();
+    m_tables.clear();
+}
 
-    if ((fd = open(m_program_path.c_str(), O_RDONLY)) < 0) {
-        printf("Err: open\n");
-        exit(-1);
+void Elf_parser::load_memory_map(const map_options_t &options) {
+    int fd;
+    if ((fd = ::open(m_program_path.c_str(), O_RDONLY | O_CLOEXEC)) < 0)
+        throw Elf_error("Err: open " + m_program_path, Elf_errc::io);
+
+    if (options.stream) {
+        // the reader owns fd from here on
+        open_stream(fd, options);
+    } else {
+        try {
+            map_fd(fd, options);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        // the mapping keeps the file alive; the descriptor is no longer needed
+        close(fd);
     }
+    load_headers();
+}
+
+void Elf_parser::map_fd(int fd, const map_options_t &options) {
+    ELF_STATS_TIMER(map_ns);
+    struct stat st;
+
+    if (fstat(fd, &st) < 0)
+        throw Elf_error("Err: fstat " + m_program_path, Elf_errc::io);
+    if ((size_t)st.st_size < sizeof(Elf32_Ehdr))
+        throw Elf_error("Not an ELF file: " + m_program_path, Elf_errc::not_elf);
+
+    int flags = MAP_PRIVATE | (options.populate ? MAP_POPULATE : 0);
+    void *map = mmap(NULL, st.st_size, PROT_READ, flags, fd, 0);
+    if (map == MAP_FAILED)
+        throw Elf_error("Err: mmap " + m_program_path, Elf_errc::io);
+
+    m_mmap_program = static_cast<uint8_t*>(map);
+    m_program_size = st.st_size;
+    m_owns_map = true;
+
+    if (options.advice != MADV_NORMAL)
+        madvise(map, st.st_size, options.advice);
+}
+
+void Elf_parser::open_stream(int fd, const map_options_t &options) {
+    ELF_STATS_TIMER(map_ns);
+    struct stat st;
+
     if (fstat(fd, &st) < 0) {
-        printf("Err: fstat\n");
-        exit(-1);
+        close(fd);
+        throw Elf_error("Err: fstat " + m_program_path, Elf_errc::io);
+    }
+    m_reader.reset(new Pread_reader(fd, st.st_size, options.stream_cache_bytes));
+    m_program_size = st.st_size;
+
+    if ((size_t)st.st_size < sizeof(Elf32_Ehdr)) {
+        release();
+        throw Elf_error("Not an ELF file: " + m_program_path, Elf_errc::not_elf);
+    }
+}
+
+namespace {
+const unsigned char host_data =
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) ? ELFDATA2LSB : ELFDATA2MSB;
+
+template <int Class> struct elf_types;
+
+template <> struct elf_types<ELFCLASS32> {
+    typedef Elf32_Ehdr Ehdr; typedef Elf32_Phdr Phdr; typedef Elf32_Shdr Shdr;
+    typedef Elf32_Sym Sym; typedef Elf32_Rel Rel; typedef Elf32_Rela Rela;
+    typedef Elf32_Dyn Dyn; typedef uint32_t Addr;
+    static uint64_t r_info(uint64_t info) { return ELF64_R_INFO(ELF32_R_SYM(info), ELF32_R_TYPE(info)); }
+};
+
+template <> struct elf_types<ELFCLASS64> {
+    typedef Elf64_Ehdr Ehdr; typedef Elf64_Phdr Phdr; typedef Elf64_Shdr Shdr;
+    typedef Elf64_Sym Sym; typedef Elf64_Rel Rel; typedef Elf64_Rela Rela;
+    typedef Elf64_Dyn Dyn; typedef uint64_t Addr;
+    static uint64_t r_info(uint64_t info) { return info; }
+};
+
+/* Rewrites a file of another ELF class or byte order into native ELF64.
+ * The image starts with a copy of the file, so code, strings and every
+ * original offset stay valid; same-sized tables (notes, hash tables) are
+ * byte swapped in place, and the header tables, symbol, relocation and
+ * dynamic tables are appended in Elf64 form. Section headers keep the
+ * file's offsets and sizes; tables() says where each converted copy went.
+ * When Swap is false the swaps compile away. */
+template <int Class, bool Swap>
+class Elf_normalizer {
+    public:
+        typedef elf_types<Class> T;
+
+        Elf_normalizer(const uint8_t *file, size_t size, const std::string &path)
+            : m_image(file, file + size), m_size{size}, m_path{path} {}
+
+        /* returns the offset of the Elf64 header inside the image */
+        size_t run() {
+            auto ehdr = load<typename T::Ehdr>(0);
+            Elf64_Ehdr e64;
+            memcpy(e64.e_ident, ehdr.e_ident, EI_NIDENT);
+            e64.e_ident[EI_CLASS] = ELFCLASS64;
+            e64.e_ident[EI_DATA] = host_data;
+            e64.e_type = get(ehdr.e_type);
+            e64.e_machine = get(ehdr.e_machine);
+            e64.e_version = get(ehdr.e_version);
+            e64.e_entry = get(ehdr.e_entry);
+            e64.e_flags = get(ehdr.e_flags);
+            e64.e_ehsize = sizeof(Elf64_Ehdr);
+            e64.e_phentsize = sizeof(Elf64_Phdr);
+            e64.e_phnum = get(ehdr.e_phnum);
+            e64.e_shentsize = sizeof(Elf64_Shdr);
+            e64.e_shnum = get(ehdr.e_shnum);
+            e64.e_shstrndx = get(ehdr.e_shstrndx);
+
+            std::vector<Elf64_Phdr> phdrs(e64.e_phnum);
+            for (size_t i = 0; i < phdrs.size(); ++i)
+                phdrs[i] = convert_phdr(load<typename T::Phdr>(
+                    get(ehdr.e_phoff) + i * get(ehdr.e_phentsize)));
+
+            std::vector<Elf64_Shdr> shdrs(e64.e_shnum);
+            for (size_t i = 0; i < shdrs.size(); ++i)
+                shdrs[i] = convert_shdr(load<typename T::Shdr>(
+                    get(ehdr.e_shoff) + i * get(ehdr.e_shentsize)));
+
+            // note payloads are swapped once, through the segment when
+            // one covers them
+            for (auto &phdr : phdrs) {
+                if ((phdr.p_type == PT_NOTE) && in_file(phdr.p_offset, phdr.p_filesz))
+                    swap_notes(phdr.p_offset, phdr.p_filesz);
+            }
+            m_tables.resize(shdrs.size());
+            for (size_t i = 0; i < shdrs.size(); ++i) {
+                auto &shdr = shdrs[i];
+                if ((shdr.sh_type == SHT_NOBITS) || !in_file(shdr.sh_offset, shdr.sh_size))
+                    continue;
+                if ((shdr.sh_type == SHT_NOTE) && !covered_by_note(phdrs, shdr))
+                    swap_notes(shdr.sh_offset, shdr.sh_size);
+                convert_section(shdr, m_tables[i]);
+            }
+
+            e64.e_phoff = append(phdrs.data(), phdrs.size());
+            e64.e_shoff = append(shdrs.data(), shdrs.size());
+            return append(&e64, 1);
+        }
+
+        std::vector<uint8_t> &image() { return m_image; }
+        std::vector<std::pair<uint64_t, uint64_t>> &tables() { return m_tables; }
+
+    private:
+        template <typename V> static V get(V v) {
+            if constexpr (Swap && (sizeof(V) == 2))
+                return (V)__builtin_bswap16(v);
+            else if constexpr (Swap && (sizeof(V) == 4))
+                return (V)__builtin_bswap32(v);
+            else if constexpr (Swap && (sizeof(V) == 8))
+                return (V)__builtin_bswap64(v);
+            else
+                return v;
+        }
+
+        bool in_file(uint64_t offset, uint64_t size) const {
+            return (offset <= m_size) && (size <= m_size - offset);
+        }
+
+        template <typename S> S load(uint64_t offset) const {
+            if (!in_file(offset, sizeof(S)))
+                throw Elf_error("Truncated ELF file: " + m_path, Elf_errc::truncated);
+            S s;
+            memcpy(&s, m_image.data() + offset, sizeof(S));
+            return s;
+        }
+
+        template <typename S> void store(uint64_t offset, const S &s) {
+            memcpy(m_image.data() + offset, &s, sizeof(S));
+        }
+
+        template <typename S> uint64_t append(const S *data, size_t count) {
+            m_image.resize((m_image.size() + 7) & ~(size_t)7, 0);
+            uint64_t offset = m_image.size();
+            m_image.insert(m_image.end(), (const uint8_t*)data, (const uint8_t*)(data + count));
+            return offset;
+        }
+
+        Elf64_Phdr convert_phdr(const typename T::Phdr &p) const {
+            Elf64_Phdr p64;
+            p64.p_type = get(p.p_type);
+            p64.p_flags = get(p.p_flags);
+            p64.p_offset = get(p.p_offset);
+            p64.p_vaddr = get(p.p_vaddr);
+            p64.p_paddr = get(p.p_paddr);
+            p64.p_filesz = get(p.p_filesz);
+            p64.p_memsz = get(p.p_memsz);
+            p64.p_align = get(p.p_align);
+            return p64;
+        }
+
+        Elf64_Shdr convert_shdr(const typename T::Shdr &s) const {
+            Elf64_Shdr s64;
+            s64.sh_name = get(s.sh_name);
+            s64.sh_type = get(s.sh_type);
+            s64.sh_flags = get(s.sh_flags);
+            s64.sh_addr = get(s.sh_addr);
+            s64.sh_offset = get(s.sh_offset);
+            s64.sh_size = get(s.sh_size);
+            s64.sh_link = get(s.sh_link);
+            s64.sh_info = get(s.sh_info);
+            s64.sh_addralign = get(s.sh_addralign);
+            s64.sh_entsize = get(s.sh_entsize);
+            return s64;
+        }
+
+        static bool covered_by_note(const std::vector<Elf64_Phdr> &phdrs, const Elf64_Shdr &shdr) {
+            for (auto &phdr : phdrs) {
+                if ((phdr.p_type == PT_NOTE) && (shdr.sh_offset >= phdr.p_offset) &&
+                    (shdr.sh_offset + shdr.sh_size <= phdr.p_offset + phdr.p_filesz))
+                    return true;
+            }
+            return false;
+        }
+
+        // Elf32_Nhdr and Elf64_Nhdr are the same three words
+        void swap_notes(uint64_t offset, uint64_t size) {
+            if constexpr (Swap) {
+                uint64_t end = offset + size;
+                while (offset + sizeof(Elf64_Nhdr) <= end) {
+                    auto nhdr = load<Elf64_Nhdr>(offset);
+                    nhdr.n_namesz = get(nhdr.n_namesz);
+                    nhdr.n_descsz = get(nhdr.n_descsz);
+                    nhdr.n_type = get(nhdr.n_type);
+                    store(offset, nhdr);
+                    offset += sizeof(Elf64_Nhdr) + ((nhdr.n_namesz + 3ull) & ~3ull) +
+                              ((nhdr.n_descsz + 3ull) & ~3ull);
+                }
+            }
+        }
+
+        template <typename W> void swap_words(uint64_t offset, uint64_t count) {
+            if constexpr (Swap) {
+                for (uint64_t i = 0; i < count; ++i)
+                    store(offset + i * sizeof(W), get(load<W>(offset + i * sizeof(W))));
+            }
+        }
+
+        // rewrites the content of a table whose layout depends on the class
+        // or byte order; other sections are left as plain bytes. table gets
+        // the {offset, size} of an appended copy.
+        void convert_section(const Elf64_Shdr &shdr, std::pair<uint64_t, uint64_t> &table) {
+            switch (shdr.sh_type) {
+                case SHT_SYMTAB:
+                case SHT_DYNSYM:
+                    convert_table<typename T::Sym, Elf64_Sym>(shdr, table, [](const typename T::Sym &s) {
+                        Elf64_Sym s64;
+                        s64.st_name = get(s.st_name);
+                        s64.st_info = s.st_info;
+                        s64.st_other = s.st_other;
+                        s64.st_shndx = get(s.st_shndx);
+                        s64.st_value = get(s.st_value);
+                        s64.st_size = get(s.st_size);
+                        return s64;
+                    });
+                    break;
+                case SHT_RELA:
+                    convert_table<typename T::Rela, Elf64_Rela>(shdr, table, [](const typename T::Rela &r) {
+                        Elf64_Rela r64;
+                        r64.r_offset = get(r.r_offset);
+                        r64.r_info = T::r_info(get(r.r_info));
+                        r64.r_addend = get(r.r_addend);
+                        return r64;
+                    });
+                    break;
+                case SHT_REL:
+                    convert_table<typename T::Rel, Elf64_Rel>(shdr, table, [](const typename T::Rel &r) {
+                        Elf64_Rel r64;
+                        r64.r_offset = get(r.r_offset);
+                        r64.r_info = T::r_info(get(r.r_info));
+                        return r64;
+                    });
+                    break;
+                case SHT_DYNAMIC:
+                    convert_table<typename T::Dyn, Elf64_Dyn>(shdr, table, [](const typename T::Dyn &d) {
+                        Elf64_Dyn d64;
+                        d64.d_tag = get(d.d_tag);
+                        d64.d_un.d_val = get(d.d_un.d_val);
+                        return d64;
+                    });
+                    break;
+                case SHT_RELR:
+                    convert_relr(shdr, table);
+                    break;
+                case SHT_HASH:
+                    swap_words<uint32_t>(shdr.sh_offset, shdr.sh_size / 4);
+                    break;
+                case SHT_GNU_versym:
+                    swap_words<uint16_t>(shdr.sh_offset, shdr.sh_size / 2);
+                    break;
+                case SHT_GNU_verneed:
+                    swap_verneed(shdr);
+                    break;
+                case SHT_GNU_HASH:
+                    convert_gnu_hash(shdr, table);
+                    break;
+            }
+        }
+
+        // same layout in both classes; the chain is walked with swapped links
+        void swap_verneed(const Elf64_Shdr &shdr) {
+            if constexpr (Swap) {
+                uint64_t offset = shdr.sh_offset, end = shdr.sh_offset + shdr.sh_size;
+                for (uint32_t i = 0; (i < shdr.sh_info) && (offset + sizeof(Elf64_Verneed) <= end); ++i) {
+                    auto vn = load<Elf64_Verneed>(offset);
+                    vn.vn_version = get(vn.vn_version);
+                    vn.vn_cnt = get(vn.vn_cnt);
+                    vn.vn_file = get(vn.vn_file);
+                    vn.vn_aux = get(vn.vn_aux);
+                    vn.vn_next = get(vn.vn_next);
+                    store(offset, vn);
+
+                    uint64_t aux = offset + vn.vn_aux;
+                    for (unsigned j = 0; (j < vn.vn_cnt) && (aux + sizeof(Elf64_Vernaux) <= end); ++j) {
+                        auto vna = load<Elf64_Vernaux>(aux);
+                        vna.vna_hash = get(vna.vna_hash);
+                        vna.vna_flags = get(vna.vna_flags);
+                        vna.vna_other = get(vna.vna_other);
+                        vna.vna_name = get(vna.vna_name);
+                        vna.vna_next = get(vna.vna_next);
+                        store(aux, vna);
+                        if (!vna.vna_next)
+                            break;
+                        aux += vna.vna_next;
+                    }
+                    if (!vn.vn_next)
+                        break;
+                    offset += vn.vn_next;
+                }
+            }
+        }
+
+        template <typename From, typename To, typename Fn>
+        void convert_table(const Elf64_Shdr &shdr, std::pair<uint64_t, uint64_t> &table, Fn convert) {
+            size_t count = shdr.sh_size / sizeof(From);
+            std::vector<To> entries(count);
+            for (size_t i = 0; i < count; ++i)
+                entries[i] = convert(load<From>(shdr.sh_offset + i * sizeof(From)));
+            table = {append(entries.data(), count), count * sizeof(To)};
+        }
+
+        // 32-bit RELR bitmaps cover 31 words; they are expanded into plain
+        // address entries, which are valid 64-bit RELR as well
+        void convert_relr(const Elf64_Shdr &shdr, std::pair<uint64_t, uint64_t> &table) {
+            if constexpr (Class == ELFCLASS64) {
+                swap_words<uint64_t>(shdr.sh_offset, shdr.sh_size / 8);
+            } else {
+                std::vector<uint64_t> addrs;
+                uint64_t where = 0;
+                for (uint64_t i = 0; i < shdr.sh_size / 4; ++i) {
+                    uint32_t entry = get(load<uint32_t>(shdr.sh_offset + i * 4));
+                    if (!(entry & 1)) {
+                        addrs.push_back(entry);
+                        where = entry + 4;
+                        continue;
+                    }
+                    for (unsigned bit = 1; bit < 32; ++bit) {
+                        if ((entry >> bit) & 1)
+                            addrs.push_back(where + (bit - 1) * 4);
+                    }
+                    where += 31 * 4;
+                }
+                table = {append(addrs.data(), addrs.size()), addrs.size() * 8};
+            }
+        }
+
+        // header, Bloom words of the class's size, then buckets and chains
+        void convert_gnu_hash(const Elf64_Shdr &shdr, std::pair<uint64_t, uint64_t> &table) {
+            if (shdr.sh_size < 16)
+                return;
+            uint64_t offset = shdr.sh_offset;
+            uint32_t bloom_size = get(load<uint32_t>(offset + 8));
+            if constexpr (Class == ELFCLASS64) {
+                swap_words<uint32_t>(offset, 4);
+                swap_words<uint64_t>(offset + 16, bloom_size);
+                uint64_t rest = offset + 16 + 8ull * bloom_size;
+                if (rest <= offset + shdr.sh_size)
+                    swap_words<uint32_t>(rest, (offset + shdr.sh_size - rest) / 4);
+            } else {
+                // the 32-bit filter does not carry over to 64-bit words; a
+                // single all-ones word lets every lookup through
+                std::vector<uint32_t> words(shdr.sh_size / 4);
+                for (size_t i = 0; i < words.size(); ++i)
+                    words[i] = get(load<uint32_t>(offset + i * 4));
+                if (4 + (uint64_t)bloom_size > words.size())
+                    return;
+                std::vector<uint32_t> hash = {words[0], words[1], 1, 0, ~0u, ~0u};
+                hash.insert(hash.end(), words.begin() + 4 + bloom_size, words.end());
+                table = {append(hash.data(), hash.size()), hash.size() * 4};
+            }
+        }
+
+        std::vector<uint8_t> m_image;
+        std::vector<std::pair<uint64_t, uint64_t>> m_tables;
+        size_t m_size;
+        const std::string &m_path;
+};
+
+template <int Class, bool Swap>
+size_t normalize(const uint8_t *file, size_t size, const std::string &path,
+                 std::vector<uint8_t> &image, std::vector<std::pair<uint64_t, uint64_t>> &tables) {
+    Elf_normalizer<Class, Swap> normalizer(file, size, path);
+    size_t ehdr = normalizer.run();
+    image.swap(normalizer.image());
+    tables.swap(normalizer.tables());
+    return ehdr;
+}
+}
+
+// runs last in every constructor: on failure the mapping is dropped here,
+// since the destructor does not run for a throwing constructor
+void Elf_parser::load_headers() {
+    ELF_STATS_TIMER(header_ns);
+    if (!m_mmap_program && !m_reader) {
+        release();
+        throw Elf_error("Not an ELF file: " + m_program_path, Elf_errc::not_elf);
+    }
+
+    // the header tables stay pinned for the parser's lifetime
+    auto read_pinned = [this](uint64_t offset, uint64_t size, std::shared_ptr<const void> &keep) {
+        ELF_STATS_ADD(bytes_touched, size);
+        if (m_mmap_program)
+            return (const uint8_t*)m_mmap_program + offset;
+        auto buf = m_reader->read(offset, size, false);
+        keep = buf;
+        return (const uint8_t*)buf->data();
+    };
+
+    try {
+        m_ehdr = (const Elf64_Ehdr*)read_pinned(0, sizeof(Elf64_Ehdr), m_keep_headers[0]);
+        if ((m_program_size < EI_NIDENT) || (memcmp(m_ehdr->e_ident, ELFMAG, SELFMAG) != 0))
+            throw Elf_error("Not an ELF file: " + m_program_path, Elf_errc::not_elf);
+
+        m_class = m_ehdr->e_ident[EI_CLASS];
+        m_data = m_ehdr->e_ident[EI_DATA];
+        if (((m_class != ELFCLASS32) && (m_class != ELFCLASS64)) ||
+                ((m_data != ELFDATA2LSB) && (m_data != ELFDATA2MSB)))
+            throw Elf_error("Unsupported ELF class or byte order: " + m_program_path,
+                            Elf_errc::unsupported);
+
+        uint64_t file_size = m_program_size;
+        if ((m_class == ELFCLASS64) && (m_data == host_data)) {
+            if (m_program_size < sizeof(Elf64_Ehdr))
+                throw Elf_error("Not an ELF file: " + m_program_path, Elf_errc::not_elf);
+            if ((m_ehdr->e_phnum && (m_ehdr->e_phentsize != sizeof(Elf64_Phdr))) ||
+                    (m_ehdr->e_shnum && (m_ehdr->e_shentsize != sizeof(Elf64_Shdr))))
+                throw Elf_error("Bad header table entry size: " + m_program_path, Elf_errc::bad_header);
+            if ((m_ehdr->e_phoff > file_size) ||
+                    (m_ehdr->e_phnum * sizeof(Elf64_Phdr) > file_size - m_ehdr->e_phoff))
+                throw Elf_error("Truncated program header table: " + m_program_path, Elf_errc::truncated);
+            if ((m_ehdr->e_shoff > file_size) ||
+                    (m_ehdr->e_shnum * sizeof(Elf64_Shdr) > file_size - m_ehdr->e_shoff))
+                throw Elf_error("Truncated section header table: " + m_program_path, Elf_errc::truncated);
+            m_phdr = (const Elf64_Phdr*)read_pinned(m_ehdr->e_phoff,
+                        m_ehdr->e_phnum * sizeof(Elf64_Phdr), m_keep_headers[1]);
+            m_shdr = (const Elf64_Shdr*)read_pinned(m_ehdr->e_shoff,
+                        m_ehdr->e_shnum * sizeof(Elf64_Shdr), m_keep_headers[2]);
+        } else {
+            load_foreign();
+        }
+        validate(file_size);
+
+        m_shstrtab = nullptr;
+        if ((m_ehdr->e_shstrndx != SHN_UNDEF) && (m_ehdr->e_shstrndx < m_ehdr->e_shnum)) {
+            auto &shstrtab = m_shdr[m_ehdr->e_shstrndx];
+            m_shstrtab = (const char*)read_pinned(shstrtab.sh_offset, shstrtab.sh_size, m_keep_headers[3]);
+            // a terminating NUL bounds every name validate() let through
+            if (shstrtab.sh_size && m_shstrtab[shstrtab.sh_size - 1])
+                throw Elf_error("Section name string table not NUL terminated: " + m_program_path,
+                                Elf_errc::bad_string_table);
+        }
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+// The validation pass over the header tables, run once at open time. A
+// rewritten image is checked against the original file, whose bytes it
+// starts with. Table contents (symbol names and their string table, hash
+// tables) are checked once per table on first use, where they get read
+// anyway.
+void Elf_parser::validate(uint64_t file_size) {
+    auto in_file = [file_size](uint64_t offset, uint64_t size) {
+        return (offset <= file_size) && (size <= file_size - offset);
+    };
+    auto fail = [this](Elf_errc code, const std::string &what) {
+        throw Elf_error(what + ": " + m_program_path, code);
+    };
+
+    for (int i = 0; i < m_ehdr->e_phnum; ++i) {
+        if (!in_file(m_phdr[i].p_offset, m_phdr[i].p_filesz))
+            fail(Elf_errc::bad_segment, "Segment " + std::to_string(i) + " past end of file");
+    }
+
+    size_t shnum = m_ehdr->e_shnum;
+    for (size_t i = 0; i < shnum; ++i) {
+        auto &shdr = m_shdr[i];
+        if ((shdr.sh_type != SHT_NOBITS) && !in_file(shdr.sh_offset, shdr.sh_size))
+            fail(Elf_errc::bad_section, "Section " + std::to_string(i) + " past end of file");
+    }
+
+    uint16_t shstrndx = m_ehdr->e_shstrndx;
+    if (shnum && (shstrndx != SHN_UNDEF) && (shstrndx != SHN_XINDEX)) {
+        if ((shstrndx >= shnum) || (m_shdr[shstrndx].sh_type != SHT_STRTAB))
+            fail(Elf_errc::bad_header, "Bad section name string table index");
+        for (size_t i = 0; i < shnum; ++i) {
+            if (m_shdr[i].sh_name >= m_shdr[shstrndx].sh_size)
+                fail(Elf_errc::bad_name, "Section " + std::to_string(i) + " name out of range");
+        }
+    }
+
+    m_cache->names_checked.reset(new std::atomic<bool>[shnum]());
+}
+
+// open(): view every table symbols are resolved through and set up the
+// hash lookup, so that their contents are checked now rather than by the
+// first getter to touch them
+void Elf_parser::validate_tables() const {
+    build_dynamic_lookup();
+    auto secs = sections();
+    for (auto sec : secs) {
+        switch (sec.header->sh_type) {
+            case SHT_SYMTAB: case SHT_DYNSYM:
+                symbols(sec);
+                break;
+            case SHT_REL: case SHT_RELA: case SHT_HASH: case SHT_GNU_HASH:
+                if (sec.header->sh_link < secs.size())
+                    symbols(secs[sec.header->sh_link]);
+                break;
+        }
+    }
+}
+
+Elf_result<Elf_parser> Elf_parser::open(const std::string &program_path,
+                                        const map_options_t &options) noexcept {
+    try {
+        Elf_parser elf(program_path, options);
+        elf.validate_tables();
+        return Elf_result<Elf_parser>(std::move(elf));
+    } catch (const Elf_error &e) {
+        return Elf_result<Elf_parser>(e);
+    } catch (const std::exception &e) {
+        return Elf_result<Elf_parser>(Elf_error(e.what()));
+    }
+}
+
+Elf_result<Elf_parser> Elf_parser::open(const uint8_t *data, size_t size) noexcept {
+    try {
+        Elf_parser elf(data, size);
+        elf.validate_tables();
+        return Elf_result<Elf_parser>(std::move(elf));
+    } catch (const Elf_error &e) {
+        return Elf_result<Elf_parser>(e);
+    } catch (const std::exception &e) {
+        return Elf_result<Elf_parser>(Elf_error(e.what()));
+    }
+}
+
+// ELF32 or non-native byte order: rewrite into an owned native ELF64 image,
+// so everything past the open runs the same code as for native files
+void Elf_parser::load_foreign() {
+    // the whole file is needed; streaming mode reads it in one go
+    std::shared_ptr<const void> keep;
+    const uint8_t *file = m_mmap_program;
+    if (!file) {
+        auto buf = m_reader->read(0, m_program_size, false);
+        keep = buf;
+        file = buf->data();
+    }
+
+    std::vector<uint8_t> image;
+    std::vector<std::pair<uint64_t, uint64_t>> tables;
+    size_t ehdr;
+    if (m_class == ELFCLASS64)
+        ehdr = normalize<ELFCLASS64, true>(file, m_program_size, m_program_path, image, tables);
+    else if (m_data == host_data)
+        ehdr = normalize<ELFCLASS32, false>(file, m_program_size, m_program_path, image, tables);
+    else
+        ehdr = normalize<ELFCLASS32, true>(file, m_program_size, m_program_path, image, tables);
+
+    release();
+    for (auto &keep_header : m_keep_headers)
+        keep_header.reset();
+
+    m_image.swap(image);
+    m_tables.swap(tables);
+    m_mmap_program = m_image.data();
+    m_program_size = m_image.size();
+    m_ehdr = (const Elf64_Ehdr*)(m_mmap_program + ehdr);
+    m_phdr = (const Elf64_Phdr*)(m_mmap_program + m_ehdr->e_phoff);
+    m_shdr = (const Elf64_Shdr*)(m_mmap_program + m_ehdr->e_shoff);
+}
+
+static uint32_t gnu_hash(std::string_view name) {
+    uint32_t h = 5381;
+    for (unsigned char c : name)
+        h = (h << 5) + h + c;
+    return h;
+}
+
+static uint32_t sysv_hash(std::string_view name) {
+    uint32_t h = 0, g;
+    for (unsigned char c : name) {
+        h = (h << 4) + c;
+        if ((g = h & 0xf0000000))
+            h ^= g >> 24;
+        h &= ~g;
+    }
+    return h;
+}
+
+void Elf_parser::build_dynamic_lookup() const {
+    std::call_once(m_cache->dynamic_once, [this] {
+        auto secs = sections();
+        auto &lookup = m_cache->dynamic;
+
+        // the hash tables index the symbol table they link to; the first
+        // usable one wins and the table stays pinned alongside it
+        for (auto &sec : find_sections(SHT_GNU_HASH)) {
+            if (sec.header->sh_link >= secs.size())
+                continue;
+            uint64_t size;
+            auto table = (const uint32_t*)table_bytes(sec, size, lookup.keep_hash);
+            // the chain has no stored length and runs to the end of the
+            // section, after the header, Bloom filter and buckets
+            if ((size < 16) || (size - 16 < 8ull * table[2] + 4ull * table[0]) || (table[3] >= 32))
+                throw Elf_error("Bad .gnu.hash table: " + m_program_path, Elf_errc::bad_hash_table);
+            lookup.gnu_hash = table;
+            lookup.gnu_chain_end = table[1] + (size - 16 - 8ull * table[2] - 4ull * table[0]) / 4;
+            lookup.dynsym = symbols(secs[sec.header->sh_link]);
+            return;
+        }
+        for (auto &sec : find_sections(SHT_HASH)) {
+            if (sec.header->sh_link >= secs.size())
+                continue;
+            uint64_t size;
+            auto table = (const uint32_t*)table_bytes(sec, size, lookup.keep_hash);
+            if ((size < 8) || (size - 8 < 4ull * table[0] + 4ull * table[1]))
+                throw Elf_error("Bad .hash table: " + m_program_path, Elf_errc::bad_hash_table);
+            lookup.sysv_hash = table;
+            lookup.dynsym = symbols(secs[sec.header->sh_link]);
+            return;
+        }
+        for (auto &sec : find_sections(SHT_DYNSYM)) {
+            lookup.dynsym = symbols(sec);
+            return;
+        }
+    });
+}
+
+std::optional<symbol_ref_t> Elf_parser::find_dynamic_symbol(std::string_view name) const {
+    build_dynamic_lookup();
+    auto &lookup = m_cache->dynamic;
+
+    if (lookup.gnu_hash)
+        return gnu_hash_lookup(lookup.gnu_hash, lookup.gnu_chain_end, lookup.dynsym, name);
+
+    if (lookup.sysv_hash)
+        return sysv_hash_lookup(lookup.sysv_hash, lookup.dynsym, name);
+
+    for (auto sym : lookup.dynsym) {
+        if ((sym.sym->st_shndx != SHN_UNDEF) && (sym.name == name))
+            return sym;
+    }
+    return std::nullopt;
+}
+
+// NT_GNU_BUILD_ID descriptor inside one SHT_NOTE/PT_NOTE payload
+static std::string find_build_id(const uint8_t *notes, uint64_t size) {
+    uint64_t offset = 0;
+    while (offset + sizeof(Elf64_Nhdr) <= size) {
+        auto *nhdr = (const Elf64_Nhdr*)(notes + offset);
+        uint64_t name_size = (nhdr->n_namesz + 3) & ~3ull;
+        uint64_t desc_size = (nhdr->n_descsz + 3) & ~3ull;
+        uint64_t desc = offset + sizeof(Elf64_Nhdr) + name_size;
+        if (desc + nhdr->n_descsz > size)
+            break;
+        if ((nhdr->n_type == NT_GNU_BUILD_ID) && (nhdr->n_namesz == 4) &&
+            !memcmp(notes + offset + sizeof(Elf64_Nhdr), "GNU", 4))
+            return std::string((const char*)notes + desc, nhdr->n_descsz);
+        offset = desc + desc_size;
+    }
+    return std::string();
+}
+
+std::string Elf_parser::get_build_id() const {
+    std::shared_ptr<const void> keep;
+
+    // loaded objects carry it in a PT_NOTE; fall back to the note sections
+    for (int i = 0; i < m_ehdr->e_phnum; ++i) {
+        auto &phdr = m_phdr[i];
+        if (phdr.p_type != PT_NOTE)
+            continue;
+        auto id = find_build_id(read_bytes(phdr.p_offset, phdr.p_filesz, keep), phdr.p_filesz);
+        if (!id.empty())
+            return id;
+    }
+    for (auto &sec : find_sections(SHT_NOTE)) {
+        auto *shdr = sec.header;
+        auto id = find_build_id(read_bytes(shdr->sh_offset, shdr->sh_size, keep), shdr->sh_size);
+        if (!id.empty())
+            return id;
+    }
+    return std::string();
+}
+
+std::optional<Elf64_Chdr> Elf_parser::get_compression_header(const section_ref_t &sec) const {
+    auto *shdr = sec.header;
+    size_t size = (m_class == ELFCLASS32) ? sizeof(Elf32_Chdr) : sizeof(Elf64_Chdr);
+    if (!(shdr->sh_flags & SHF_COMPRESSED) || (shdr->sh_type == SHT_NOBITS) ||
+            (size > shdr->sh_size))
+        return std::nullopt;
+
+    std::shared_ptr<const void> keep;
+    auto *bytes = read_bytes(shdr->sh_offset, size, keep);
+    bool swap = (m_data != ELFDATANONE) && (m_data != host_data);
+    Elf64_Chdr chdr{};
+    if (m_class == ELFCLASS32) {
+        Elf32_Chdr c32;
+        memcpy(&c32, bytes, sizeof(c32));
+        chdr.ch_type = swap ? __builtin_bswap32(c32.ch_type) : c32.ch_type;
+        chdr.ch_size = swap ? __builtin_bswap32(c32.ch_size) : c32.ch_size;
+        chdr.ch_addralign = swap ? __builtin_bswap32(c32.ch_addralign) : c32.ch_addralign;
+    } else {
+        memcpy(&chdr, bytes, sizeof(chdr));
+        if (swap) {
+            chdr.ch_type = __builtin_bswap32(chdr.ch_type);
+            chdr.ch_size = __builtin_bswap64(chdr.ch_size);
+            chdr.ch_addralign = __builtin_bswap64(chdr.ch_addralign);
+        }
     }
-    m_mmap_program = static_cast<uint8_t*>(mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
-    if (m_mmap_program == MAP_FAILED) {
-        printf("Err: mmap\n");
-        exit(-1);
+    return chdr;
+}
+
+std::string_view Elf_parser::section_data(const section_ref_t &sec,
+                                         std::shared_ptr<const void> &keep) const {
+    auto *shdr = sec.header;
+    if ((shdr->sh_type == SHT_NOBITS) || (shdr->sh_size == 0))
+        return std::string_view();
+    return std::string_view((const char*)read_bytes(shdr->sh_offset, shdr->sh_size, keep), shdr->sh_size);
+}
+
+std::string_view Elf_parser::address_data(uint64_t addr, uint64_t size,
+                                          std::shared_ptr<const void> &keep) const {
+    for (int i = 0; i < m_ehdr->e_phnum; ++i) {
+        auto &phdr = m_phdr[i];
+        if ((phdr.p_type != PT_LOAD) || (addr < phdr.p_vaddr) || (addr - phdr.p_vaddr >= phdr.p_filesz))
+            continue;
+        uint64_t offset = phdr.p_offset + (addr - phdr.p_vaddr);
+        size = std::min(size, phdr.p_filesz - (addr - phdr.p_vaddr));
+        if ((offset > m_program_size) || (size > m_program_size - offset) || (size == 0))
+            return std::string_view();
+        return std::string_view((const char*)read_bytes(offset, size, keep), size);
+    }
+    return std::string_view();
+}
+
+const dynamic_info_t &Elf_parser::get_dynamic_info() const {
+    std::call_once(m_cache->dynamic_info_once, [this] {
+        auto &info = m_cache->dynamic_info;
+        auto secs = sections();
+        std::shared_ptr<const void> keep_dyn, keep_str, keep;
+
+        // the section when there is one; PT_DYNAMIC for files whose section
+        // headers were stripped (rewritten files have them converted)
+        const Elf64_Dyn *dyn = nullptr;
+        uint64_t dyn_size = 0;
+        const char *strtab = nullptr;
+        uint64_t strtab_size = 0;
+        auto &dynamics = find_sections(SHT_DYNAMIC);
+        if (!dynamics.empty()) {
+            dyn = (const Elf64_Dyn*)table_bytes(dynamics[0], dyn_size, keep_dyn);
+            if (dynamics[0].header->sh_link < secs.size()) {
+                auto *shdr = secs[dynamics[0].header->sh_link].header;
+                if (shdr->sh_type == SHT_STRTAB) {
+                    strtab = (const char*)read_bytes(shdr->sh_offset, shdr->sh_size, keep_str);
+                    strtab_size = shdr->sh_size;
+                }
+            }
+        } else if (m_tables.empty()) {
+            for (int i = 0; i < m_ehdr->e_phnum; ++i) {
+                auto &phdr = m_phdr[i];
+                if (phdr.p_type == PT_DYNAMIC) {
+                    dyn = (const Elf64_Dyn*)read_bytes(phdr.p_offset, phdr.p_filesz, keep_dyn);
+                    dyn_size = phdr.p_filesz;
+                    break;
+                }
+            }
+        }
+        if (!dyn)
+            return;
+
+        info.present = true;
+        for (size_t i = 0; (i < dyn_size / sizeof(Elf64_Dyn)) && (dyn[i].d_tag != DT_NULL); ++i)
+            info.entries.push_back({dyn[i].d_tag, dyn[i].d_un.d_val});
+
+        auto value = [&info](int64_t tag) -> uint64_t {
+            for (auto &entry : info.entries) {
+                if (entry.first == tag)
+                    return entry.second;
+            }
+            return 0;
+        };
+        if (!strtab) {
+            strtab_size = value(DT_STRSZ);
+            if (auto offset = vaddr_to_offset(value(DT_STRTAB), strtab_size))
+                strtab = (const char*)read_bytes(*offset, strtab_size, keep_str);
+        }
+
+        auto string = [&](uint64_t offset) {
+            if (!strtab || (offset >= strtab_size))
+                return std::string();
+            return std::string(strtab + offset, strnlen(strtab + offset, strtab_size - offset));
+        };
+        auto split = [](const std::string &list, std::vector<std::string> &out) {
+            size_t start = 0;
+            while (start <= list.size()) {
+                size_t end = std::min(list.find(':', start), list.size());
+                out.push_back(list.substr(start, end - start));
+                start = end + 1;
+            }
+        };
+        // array slots are address-sized words in the file's own class and
+        // byte order, read from the original bytes
+        auto words = [&](int64_t tag, int64_t size_tag, std::vector<uint64_t> &out) {
+            size_t word = (m_class == ELFCLASS32) ? 4 : 8;
+            uint64_t size = value(size_tag);
+            auto offset = vaddr_to_offset(value(tag), size);
+            if (!value(tag) || !offset)
+                return;
+            auto bytes = read_bytes(*offset, size, keep);
+            for (uint64_t i = 0; i + word <= size; i += word) {
+                uint64_t v = 0;
+                for (size_t b = 0; b < word; ++b) {
+                    size_t shift = (m_data == ELFDATA2LSB) ? b : word - 1 - b;
+                    v |= (uint64_t)bytes[i + b] << (8 * shift);
+                }
+                out.push_back(v);
+            }
+        };
+
+        for (auto &entry : info.entries) {
+            switch (entry.first) {
+                case DT_NEEDED:  info.needed.push_back(string(entry.second)); break;
+                case DT_SONAME:  info.soname = string(entry.second); break;
+                case DT_RPATH:   split(string(entry.second), info.rpath); break;
+                case DT_RUNPATH: split(string(entry.second), info.runpath); break;
+                case DT_FLAGS:   info.flags = entry.second; break;
+                case DT_FLAGS_1: info.flags_1 = entry.second; break;
+                case DT_INIT:    info.init = entry.second; break;
+                case DT_FINI:    info.fini = entry.second; break;
+            }
+        }
+        words(DT_PREINIT_ARRAY, DT_PREINIT_ARRAYSZ, info.preinit_array);
+        words(DT_INIT_ARRAY, DT_INIT_ARRAYSZ, info.init_array);
+        words(DT_FINI_ARRAY, DT_FINI_ARRAYSZ, info.fini_array);
+
+        // Elf64_Verneed and Elf32_Verneed share a layout. Without a section
+        // header the table size is unknown, so records are read one by one
+        // against the end of the file.
+        uint64_t verneed = 0, verneed_end = 0, verneed_num = value(DT_VERNEEDNUM);
+        auto &verneeds = find_sections(SHT_GNU_verneed);
+        if (!verneeds.empty()) {
+            verneed = verneeds[0].header->sh_offset;
+            verneed_end = std::min<uint64_t>(verneed + verneeds[0].header->sh_size, m_program_size);
+            verneed_num = verneeds[0].header->sh_info;
+        } else if (m_tables.empty() && value(DT_VERNEED)) {
+            if (auto offset = vaddr_to_offset(value(DT_VERNEED), 0)) {
+                verneed = *offset;
+                verneed_end = m_program_size;
+            }
+        }
+
+        uint64_t offset = verneed;
+        for (uint64_t i = 0; verneed_end && (i < verneed_num); ++i) {
+            if (offset + sizeof(Elf64_Verneed) > verneed_end)
+                break;
+            auto vn = *(const Elf64_Verneed*)read_bytes(offset, sizeof(Elf64_Verneed), keep);
+            version_need_t need;
+            need.file = string(vn.vn_file);
+
+            uint64_t aux = offset + vn.vn_aux;
+            for (unsigned j = 0; j < vn.vn_cnt; ++j) {
+                if (aux + sizeof(Elf64_Vernaux) > verneed_end)
+                    break;
+                auto vna = *(const Elf64_Vernaux*)read_bytes(aux, sizeof(Elf64_Vernaux), keep);
+                need.versions.push_back(string(vna.vna_name));
+                if (!vna.vna_next)
+                    break;
+                aux += vna.vna_next;
+            }
+            info.version_needs.push_back(std::move(need));
+            if (!vn.vn_next)
+                break;
+            offset += vn.vn_next;
+        }
+    });
+    return m_cache->dynamic_info;
+}
+
+std::optional<symbol_ref_t> Elf_parser::gnu_hash_lookup(const uint32_t *table, uint64_t chain_end,
+        const SymbolView &dynsym, std::string_view name) const {
+    uint32_t nbuckets = table[0], symoffset = table[1];
+    uint32_t bloom_size = table[2], bloom_shift = table[3];
+    if ((nbuckets == 0) || (bloom_size == 0))
+        return std::nullopt;
+
+    auto bloom   = (const uint64_t*)(table + 4);
+    auto buckets = (const uint32_t*)(bloom + bloom_size);
+    auto chain   = buckets + nbuckets;
+
+    // the Bloom filter rejects most absent names without touching the symbols
+    uint32_t h = gnu_hash(name);
+    uint64_t word = bloom[(h / 64) % bloom_size];
+    uint64_t mask = (1ull << (h % 64)) | (1ull << ((h >> bloom_shift) % 64));
+    if ((word & mask) != mask)
+        return std::nullopt;
+
+    uint32_t idx = buckets[h % nbuckets];
+    if (idx < symoffset)
+        return std::nullopt;
+
+    for (; (idx < dynsym.size()) && (idx < chain_end); ++idx) {
+        uint32_t h2 = chain[idx - symoffset];
+        if ((h | 1) == (h2 | 1)) {
+            auto sym = dynsym[idx];
+            if ((sym.sym->st_shndx != SHN_UNDEF) && (sym.name == name))
+                return sym;
+        }
+        if (h2 & 1)
+            break;
     }
+    return std::nullopt;
+}
+
+std::optional<symbol_ref_t> Elf_parser::sysv_hash_lookup(const uint32_t *table,
+        const SymbolView &dynsym, std::string_view name) const {
+    uint32_t nbucket = table[0], nchain = table[1];
+    if (nbucket == 0)
+        return std::nullopt;
 
-    auto header = (Elf64_Ehdr*)m_mmap_program;
-    if (header->e_ident[EI_CLASS] != ELFCLASS64) {
-        printf("Only 64-bit files supported\n");
-        exit(1);
+    auto bucket = table + 2;
+    auto chain  = bucket + nbucket;
+
+    // a well-formed chain visits each symbol at most once; a cyclic one
+    // runs out of steps and counts as not found
+    uint32_t idx = bucket[sysv_hash(name) % nbucket];
+    for (uint32_t steps = 0; (idx != STN_UNDEF) && (idx < nchain) && (idx < dynsym.size()) &&
+            (steps < nchain); idx = chain[idx], ++steps) {
+        auto sym = dynsym[idx];
+        if ((sym.sym->st_shndx != SHN_UNDEF) && (sym.name == name))
+            return sym;
     }
+    return std::nullopt;
 }
 
-std::string Elf_parser::get_section_type(int tt) {
+std::string Elf_parser::get_section_type(int tt) const {
     if(tt < 0)
         return "UNKNOWN";
 
@@ -226,7 +1649,7 @@ std::string Elf_parser::get_section_type(int tt) {
     return "UNKNOWN";
 }
 
-std::string Elf_parser::get_segment_type(uint32_t &seg_type) {
+std::string Elf_parser::get_segment_type(const uint32_t &seg_type) const {
     switch(seg_type) {
         case PT_NULL:   return "NULL";                  /* Program header table entry unused */ 
         case PT_LOAD: return "LOAD";                    /* Loadable program segment */
@@ -252,7 +1675,7 @@ std::string Elf_parser::get_segment_type(uint32_t &seg_type) {
     }
 }
 
-std::string Elf_parser::get_segment_flags(uint32_t &seg_flags) {
+std::string Elf_parser::get_segment_flags(const uint32_t &seg_flags) const {
     std::string flags;
 
     if(seg_flags & PF_R)
@@ -267,7 +1690,7 @@ std::string Elf_parser::get_segment_flags(uint32_t &seg_flags) {
     return flags;
 }
 
-std::string Elf_parser::get_symbol_type(uint8_t &sym_type) {
+std::string Elf_parser::get_symbol_type(const uint8_t &sym_type) const {
     switch(ELF32_ST_TYPE(sym_type)) {
         case 0: return "NOTYPE";
         case 1: return "OBJECT";
@@ -282,7 +1705,7 @@ std::string Elf_parser::get_symbol_type(uint8_t &sym_type) {
     }
 }
 
-std::string Elf_parser::get_symbol_bind(uint8_t &sym_bind) {
+std::string Elf_parser::get_symbol_bind(const uint8_t &sym_bind) const {
     switch(ELF32_ST_BIND(sym_bind)) {
         case 0: return "LOCAL";
         case 1: return "GLOBAL";
@@ -295,7 +1718,7 @@ std::string Elf_parser::get_symbol_bind(uint8_t &sym_bind) {
     }
 }
 
-std::string Elf_parser::get_symbol_visibility(uint8_t &sym_vis) {
+std::string Elf_parser::get_symbol_visibility(const uint8_t &sym_vis) const {
     switch(ELF32_ST_VISIBILITY(sym_vis)) {
         case 0: return "DEFAULT";
         case 1: return "INTERNAL";
@@ -305,7 +1728,7 @@ std::string Elf_parser::get_symbol_visibility(uint8_t &sym_vis) {
     }
 }
 
-std::string Elf_parser::get_symbol_index(uint16_t &sym_idx) {
+std::string Elf_parser::get_symbol_index(const uint16_t &sym_idx) const {
     switch(sym_idx) {
         case SHN_ABS: return "ABS";
         case SHN_COMMON: return "COM";
@@ -315,39 +1738,149 @@ std::string Elf_parser::get_symbol_index(uint16_t &sym_idx) {
     }
 }
 
-std::string Elf_parser::get_relocation_type(uint64_t &rela_type) {
-    switch(ELF64_R_TYPE(rela_type)) {
-        case 1: return "R_X86_64_32";
-        case 2: return "R_X86_64_PC32";
-        case 5: return "R_X86_64_COPY";
-        case 6: return "R_X86_64_GLOB_DAT";
-        case 7:  return "R_X86_64_JUMP_SLOT";
-        default: return "OTHERS";
+// per-machine relocation names, sorted by type for a binary search
+typedef struct {
+    uint32_t type;
+    const char *name;
+} reloc_name_t;
+
+#define RELOC(name) {name, #name}
+
+static const reloc_name_t x86_64_relocs[] = {
+    RELOC(R_X86_64_NONE), RELOC(R_X86_64_64), RELOC(R_X86_64_PC32), RELOC(R_X86_64_GOT32),
+    RELOC(R_X86_64_PLT32), RELOC(R_X86_64_COPY), RELOC(R_X86_64_GLOB_DAT),
+    RELOC(R_X86_64_JUMP_SLOT), RELOC(R_X86_64_RELATIVE), RELOC(R_X86_64_GOTPCREL),
+    RELOC(R_X86_64_32), RELOC(R_X86_64_32S), RELOC(R_X86_64_16), RELOC(R_X86_64_PC16),
+    RELOC(R_X86_64_8), RELOC(R_X86_64_PC8), RELOC(R_X86_64_DTPMOD64), RELOC(R_X86_64_DTPOFF64),
+    RELOC(R_X86_64_TPOFF64), RELOC(R_X86_64_TLSGD), RELOC(R_X86_64_TLSLD),
+    RELOC(R_X86_64_DTPOFF32), RELOC(R_X86_64_GOTTPOFF), RELOC(R_X86_64_TPOFF32),
+    RELOC(R_X86_64_PC64), RELOC(R_X86_64_GOTOFF64), RELOC(R_X86_64_GOTPC32),
+    RELOC(R_X86_64_GOT64), RELOC(R_X86_64_GOTPCREL64), RELOC(R_X86_64_GOTPC64),
+    RELOC(R_X86_64_GOTPLT64), RELOC(R_X86_64_PLTOFF64), RELOC(R_X86_64_SIZE32),
+    RELOC(R_X86_64_SIZE64), RELOC(R_X86_64_GOTPC32_TLSDESC), RELOC(R_X86_64_TLSDESC_CALL),
+    RELOC(R_X86_64_TLSDESC), RELOC(R_X86_64_IRELATIVE), RELOC(R_X86_64_RELATIVE64),
+    RELOC(R_X86_64_GOTPCRELX), RELOC(R_X86_64_REX_GOTPCRELX)
+};
+
+static const reloc_name_t i386_relocs[] = {
+    RELOC(R_386_NONE), RELOC(R_386_32), RELOC(R_386_PC32), RELOC(R_386_GOT32),
+    RELOC(R_386_PLT32), RELOC(R_386_COPY), RELOC(R_386_GLOB_DAT), RELOC(R_386_JMP_SLOT),
+    RELOC(R_386_RELATIVE), RELOC(R_386_GOTOFF), RELOC(R_386_GOTPC), RELOC(R_386_32PLT),
+    RELOC(R_386_TLS_TPOFF), RELOC(R_386_TLS_IE), RELOC(R_386_TLS_GOTIE), RELOC(R_386_TLS_LE),
+    RELOC(R_386_TLS_GD), RELOC(R_386_TLS_LDM), RELOC(R_386_16), RELOC(R_386_PC16),
+    RELOC(R_386_8), RELOC(R_386_PC8), RELOC(R_386_TLS_GD_32), RELOC(R_386_TLS_GD_PUSH),
+    RELOC(R_386_TLS_GD_CALL), RELOC(R_386_TLS_GD_POP), RELOC(R_386_TLS_LDM_32),
+    RELOC(R_386_TLS_LDM_PUSH), RELOC(R_386_TLS_LDM_CALL), RELOC(R_386_TLS_LDM_POP),
+    RELOC(R_386_TLS_LDO_32), RELOC(R_386_TLS_IE_32), RELOC(R_386_TLS_LE_32),
+    RELOC(R_386_TLS_DTPMOD32), RELOC(R_386_TLS_DTPOFF32), RELOC(R_386_TLS_TPOFF32),
+    RELOC(R_386_SIZE32), RELOC(R_386_TLS_GOTDESC), RELOC(R_386_TLS_DESC_CALL),
+    RELOC(R_386_TLS_DESC), RELOC(R_386_IRELATIVE), RELOC(R_386_GOT32X)
+};
+
+static const reloc_name_t aarch64_relocs[] = {
+    RELOC(R_AARCH64_NONE), RELOC(R_AARCH64_ABS64), RELOC(R_AARCH64_ABS32),
+    RELOC(R_AARCH64_ABS16), RELOC(R_AARCH64_PREL64), RELOC(R_AARCH64_PREL32),
+    RELOC(R_AARCH64_PREL16), RELOC(R_AARCH64_MOVW_UABS_G0), RELOC(R_AARCH64_MOVW_UABS_G0_NC),
+    RELOC(R_AARCH64_MOVW_UABS_G1), RELOC(R_AARCH64_MOVW_UABS_G1_NC),
+    RELOC(R_AARCH64_MOVW_UABS_G2), RELOC(R_AARCH64_MOVW_UABS_G2_NC),
+    RELOC(R_AARCH64_MOVW_UABS_G3), RELOC(R_AARCH64_MOVW_SABS_G0), RELOC(R_AARCH64_MOVW_SABS_G1),
+    RELOC(R_AARCH64_MOVW_SABS_G2), RELOC(R_AARCH64_LD_PREL_LO19),
+    RELOC(R_AARCH64_ADR_PREL_LO21), RELOC(R_AARCH64_ADR_PREL_PG_HI21),
+    RELOC(R_AARCH64_ADR_PREL_PG_HI21_NC), RELOC(R_AARCH64_ADD_ABS_LO12_NC),
+    RELOC(R_AARCH64_LDST8_ABS_LO12_NC), RELOC(R_AARCH64_TSTBR14), RELOC(R_AARCH64_CONDBR19),
+    RELOC(R_AARCH64_JUMP26), RELOC(R_AARCH64_CALL26), RELOC(R_AARCH64_LDST16_ABS_LO12_NC),
+    RELOC(R_AARCH64_LDST32_ABS_LO12_NC), RELOC(R_AARCH64_LDST64_ABS_LO12_NC),
+    RELOC(R_AARCH64_MOVW_PREL_G0), RELOC(R_AARCH64_MOVW_PREL_G0_NC),
+    RELOC(R_AARCH64_MOVW_PREL_G1), RELOC(R_AARCH64_MOVW_PREL_G1_NC),
+    RELOC(R_AARCH64_MOVW_PREL_G2), RELOC(R_AARCH64_MOVW_PREL_G2_NC),
+    RELOC(R_AARCH64_MOVW_PREL_G3), RELOC(R_AARCH64_LDST128_ABS_LO12_NC),
+    RELOC(R_AARCH64_MOVW_GOTOFF_G0), RELOC(R_AARCH64_MOVW_GOTOFF_G0_NC),
+    RELOC(R_AARCH64_MOVW_GOTOFF_G1), RELOC(R_AARCH64_MOVW_GOTOFF_G1_NC),
+    RELOC(R_AARCH64_MOVW_GOTOFF_G2), RELOC(R_AARCH64_MOVW_GOTOFF_G2_NC),
+    RELOC(R_AARCH64_MOVW_GOTOFF_G3), RELOC(R_AARCH64_GOTREL64), RELOC(R_AARCH64_GOTREL32),
+    RELOC(R_AARCH64_GOT_LD_PREL19), RELOC(R_AARCH64_LD64_GOTOFF_LO15),
+    RELOC(R_AARCH64_ADR_GOT_PAGE), RELOC(R_AARCH64_LD64_GOT_LO12_NC),
+    RELOC(R_AARCH64_LD64_GOTPAGE_LO15), RELOC(R_AARCH64_TLSGD_ADR_PREL21),
+    RELOC(R_AARCH64_TLSGD_ADR_PAGE21), RELOC(R_AARCH64_TLSGD_ADD_LO12_NC),
+    RELOC(R_AARCH64_TLSGD_MOVW_G1), RELOC(R_AARCH64_TLSGD_MOVW_G0_NC),
+    RELOC(R_AARCH64_TLSLD_ADR_PREL21), RELOC(R_AARCH64_TLSLD_ADR_PAGE21),
+    RELOC(R_AARCH64_TLSLD_ADD_LO12_NC), RELOC(R_AARCH64_TLSLD_MOVW_G1),
+    RELOC(R_AARCH64_TLSLD_MOVW_G0_NC), RELOC(R_AARCH64_TLSLD_LD_PREL19),
+    RELOC(R_AARCH64_TLSLD_MOVW_DTPREL_G2), RELOC(R_AARCH64_TLSLD_MOVW_DTPREL_G1),
+    RELOC(R_AARCH64_TLSLD_MOVW_DTPREL_G1_NC), RELOC(R_AARCH64_TLSLD_MOVW_DTPREL_G0),
+    RELOC(R_AARCH64_TLSLD_MOVW_DTPREL_G0_NC), RELOC(R_AARCH64_TLSLD_ADD_DTPREL_HI12),
+    RELOC(R_AARCH64_TLSLD_ADD_DTPREL_LO12), RELOC(R_AARCH64_TLSLD_ADD_DTPREL_LO12_NC),
+    RELOC(R_AARCH64_TLSLD_LDST8_DTPREL_LO12), RELOC(R_AARCH64_TLSLD_LDST8_DTPREL_LO12_NC),
+    RELOC(R_AARCH64_TLSLD_LDST16_DTPREL_LO12), RELOC(R_AARCH64_TLSLD_LDST16_DTPREL_LO12_NC),
+    RELOC(R_AARCH64_TLSLD_LDST32_DTPREL_LO12), RELOC(R_AARCH64_TLSLD_LDST32_DTPREL_LO12_NC),
+    RELOC(R_AARCH64_TLSLD_LDST64_DTPREL_LO12), RELOC(R_AARCH64_TLSLD_LDST64_DTPREL_LO12_NC),
+    RELOC(R_AARCH64_TLSIE_MOVW_GOTTPREL_G1), RELOC(R_AARCH64_TLSIE_MOVW_GOTTPREL_G0_NC),
+    RELOC(R_AARCH64_TLSIE_ADR_GOTTPREL_PAGE21), RELOC(R_AARCH64_TLSIE_LD64_GOTTPREL_LO12_NC),
+    RELOC(R_AARCH64_TLSIE_LD_GOTTPREL_PREL19), RELOC(R_AARCH64_TLSLE_MOVW_TPREL_G2),
+    RELOC(R_AARCH64_TLSLE_MOVW_TPREL_G1), RELOC(R_AARCH64_TLSLE_MOVW_TPREL_G1_NC),
+    RELOC(R_AARCH64_TLSLE_MOVW_TPREL_G0), RELOC(R_AARCH64_TLSLE_MOVW_TPREL_G0_NC),
+    RELOC(R_AARCH64_TLSLE_ADD_TPREL_HI12), RELOC(R_AARCH64_TLSLE_ADD_TPREL_LO12),
+    RELOC(R_AARCH64_TLSLE_ADD_TPREL_LO12_NC), RELOC(R_AARCH64_TLSLE_LDST8_TPREL_LO12),
+    RELOC(R_AARCH64_TLSLE_LDST8_TPREL_LO12_NC), RELOC(R_AARCH64_TLSLE_LDST16_TPREL_LO12),
+    RELOC(R_AARCH64_TLSLE_LDST16_TPREL_LO12_NC), RELOC(R_AARCH64_TLSLE_LDST32_TPREL_LO12),
+    RELOC(R_AARCH64_TLSLE_LDST32_TPREL_LO12_NC), RELOC(R_AARCH64_TLSLE_LDST64_TPREL_LO12),
+    RELOC(R_AARCH64_TLSLE_LDST64_TPREL_LO12_NC), RELOC(R_AARCH64_TLSDESC_LD_PREL19),
+    RELOC(R_AARCH64_TLSDESC_ADR_PREL21), RELOC(R_AARCH64_TLSDESC_ADR_PAGE21),
+    RELOC(R_AARCH64_TLSDESC_LD64_LO12), RELOC(R_AARCH64_TLSDESC_ADD_LO12),
+    RELOC(R_AARCH64_TLSDESC_OFF_G1), RELOC(R_AARCH64_TLSDESC_OFF_G0_NC),
+    RELOC(R_AARCH64_TLSDESC_LDR), RELOC(R_AARCH64_TLSDESC_ADD), RELOC(R_AARCH64_TLSDESC_CALL),
+    RELOC(R_AARCH64_TLSLE_LDST128_TPREL_LO12), RELOC(R_AARCH64_TLSLE_LDST128_TPREL_LO12_NC),
+    RELOC(R_AARCH64_TLSLD_LDST128_DTPREL_LO12), RELOC(R_AARCH64_TLSLD_LDST128_DTPREL_LO12_NC),
+    RELOC(R_AARCH64_COPY), RELOC(R_AARCH64_GLOB_DAT), RELOC(R_AARCH64_JUMP_SLOT),
+    RELOC(R_AARCH64_RELATIVE), RELOC(R_AARCH64_TLS_DTPMOD), RELOC(R_AARCH64_TLS_DTPREL),
+    RELOC(R_AARCH64_TLS_TPREL), RELOC(R_AARCH64_TLSDESC), RELOC(R_AARCH64_IRELATIVE)
+};
+
+#undef RELOC
+
+const char *Elf_parser::relocation_type_name(uint16_t machine, uint32_t type) {
+    const reloc_name_t *begin, *end;
+    switch (machine) {
+        case EM_X86_64:
+            begin = std::begin(x86_64_relocs), end = std::end(x86_64_relocs);
+            break;
+        case EM_386:
+            begin = std::begin(i386_relocs), end = std::end(i386_relocs);
+            break;
+        case EM_AARCH64:
+            begin = std::begin(aarch64_relocs), end = std::end(aarch64_relocs);
+            break;
+        default:
+            return nullptr;
     }
+
+    auto it = std::lower_bound(begin, end, type, [](const reloc_name_t &r, uint32_t t) {
+        return r.type < t;
+    });
+    return ((it != end) && (it->type == type)) ? it->name : nullptr;
+}
+
+std::string Elf_parser::get_relocation_type(const uint64_t &rela_type) const {
+    auto name = relocation_type_name(m_ehdr->e_machine, ELF64_R_TYPE(rela_type));
+    return name ? name : "OTHERS";
 }
 
 std::intptr_t Elf_parser::get_rel_symbol_value(
-                uint64_t &sym_idx, std::vector<symbol_t> &syms) {
+                const uint64_t &sym_idx, const SymbolView &syms) const {
+    ELF_STATS_ADD(symbol_lookups, 1);
     
     std::intptr_t sym_val = 0;
-    for(auto &sym: syms) {
-        if(sym.symbol_num == ELF64_R_SYM(sym_idx)) {
-            sym_val = sym.symbol_value;
-            break;
-        }
-    }
+    if (ELF64_R_SYM(sym_idx) < syms.size())
+        sym_val = syms[ELF64_R_SYM(sym_idx)].sym->st_value;
     return sym_val;
 }
 
 std::string Elf_parser::get_rel_symbol_name(
-                uint64_t &sym_idx, std::vector<symbol_t> &syms) {
+                const uint64_t &sym_idx, const SymbolView &syms) const {
+    ELF_STATS_ADD(symbol_lookups, 1);
 
     std::string sym_name;
-    for(auto &sym: syms) {
-        if(sym.symbol_num == ELF64_R_SYM(sym_idx)) {
-            sym_name = sym.symbol_name;
-            break;
-        }
-    }
+    if (ELF64_R_SYM(sym_idx) < syms.size())
+        sym_name = std::string(syms[ELF64_R_SYM(sym_idx)].name);
     return sym_name;
 }
@@ -25,6 +25,19 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <optional>
+#include <variant>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <atomic>
+#include <stdexcept>
+#include <functional>
+#include <unistd.h>   /* close */
+#include <iterator>
+#include <cstddef>
+#include <cstring>
 #include <cstdlib>
 #include <cstdio>
 #include <fcntl.h>    /* O_RDONLY */
@@ -36,12 +49,72 @@
 
 namespace elf_parser {
 
+/* what Elf_error::code() reports. Past io, each one comes from validation:
+ * of the header tables at open time, or of a symbol or hash table the first
+ * time it is used */
+enum class Elf_errc {
+    malformed = 1,      // any other inconsistency met while decoding
+    io,                 // open, fstat, mmap or pread failed
+    not_elf,            // shorter than an ELF header, or no ELF magic
+    unsupported,        // unknown class, byte order or section encoding
+    truncated,          // ELF header or a header table past the end of the file
+    bad_header,         // e_phentsize, e_shentsize or e_shstrndx
+    bad_segment,        // segment contents past the end of the file
+    bad_section,        // section contents past the end of the file
+    bad_string_table,   // string table without a terminating NUL
+    bad_name,           // sh_name or st_name outside its string table
+    bad_hash_table,     // .hash or .gnu.hash header and buckets overrun the section
+};
+
+/* raised when a file cannot be opened, mapped or is not a supported ELF */
+class Elf_error : public std::runtime_error {
+    public:
+        explicit Elf_error(const std::string &what, Elf_errc code = Elf_errc::malformed)
+            : std::runtime_error(what), m_code{code} {}
+        Elf_errc code() const { return m_code; }
+
+    private:
+        Elf_errc m_code;
+};
+
+/* a value, or the Elf_error that kept it from being made, for callers that
+ * would rather branch than catch */
+template <typename T>
+class Elf_result {
+    public:
+        Elf_result(T &&value): m_value{std::in_place_index<0>, std::move(value)} {}
+        Elf_result(const Elf_error &error): m_value{std::in_place_index<1>, error} {}
+
+        bool has_value() const { return m_value.index() == 0; }
+        explicit operator bool() const { return has_value(); }
+
+        /* value() throws the stored error; the operators do not check */
+        T &value() {
+            if (!has_value())
+                throw std::get<1>(m_value);
+            return std::get<0>(m_value);
+        }
+        T &operator*() { return *std::get_if<0>(&m_value); }
+        const T &operator*() const { return *std::get_if<0>(&m_value); }
+        T *operator->() { return std::get_if<0>(&m_value); }
+        const T *operator->() const { return std::get_if<0>(&m_value); }
+
+        /* only valid when has_value() is false */
+        const Elf_error &error() const { return *std::get_if<1>(&m_value); }
+
+    private:
+        std::variant<T, Elf_error> m_value;
+};
+
 typedef struct {
     int section_index = 0; 
     std::intptr_t section_offset, section_addr;
     std::string section_name;
     std::string section_type; 
     int section_size, section_ent_size, section_addr_align;
+    /* SHF_COMPRESSED sections report the uncompressed size above and the
+     * stored sh_size here; 0 for other sections */
+    std::intptr_t section_compressed_size = 0;
 } section_t;
 
 typedef struct {
@@ -61,40 +134,403 @@ typedef struct {
     std::intptr_t relocation_offset, relocation_info, relocation_symbol_value;
     std::string   relocation_type, relocation_symbol_name, relocation_section_name;
     std::intptr_t relocation_plt_address;
+    std::intptr_t relocation_addend = 0;    // REL and RELR keep theirs at the relocated place
 } relocation_t;
 
+/* one DT_VERNEED entry: a library and the symbol versions wanted from it */
+typedef struct {
+    std::string file;
+    std::vector<std::string> versions;
+} version_need_t;
 
-class Elf_parser {
+/* the PT_DYNAMIC table, decoded */
+typedef struct {
+    bool present = false;                       // false for static and relocatable files
+    std::vector<std::string> needed;            // DT_NEEDED, in load order
+    std::string soname;
+    std::vector<std::string> rpath, runpath;    // split on ':', tokens not expanded
+    uint64_t flags = 0, flags_1 = 0;            // DT_FLAGS, DT_FLAGS_1
+    uint64_t init = 0, fini = 0;                // DT_INIT, DT_FINI
+    /* function addresses as stored in the file; PIC objects may rely on
+     * relative relocations to fill them */
+    std::vector<uint64_t> preinit_array, init_array, fini_array;
+    std::vector<version_need_t> version_needs;
+    std::vector<std::pair<int64_t, uint64_t>> entries;  // every (d_tag, d_val) up to DT_NULL
+} dynamic_info_t;
+
+/* Non-owning entries handed out by the view API. They point straight into
+ * the mapped program and are only valid while the Elf_parser is alive; in
+ * streaming mode, names also need the view they came from to be alive. */
+typedef struct section_ref_t {
+    int index = 0;
+    std::string_view name;
+    const Elf64_Shdr *header = nullptr;
+
+    static section_ref_t from(const uint8_t *entry, int idx,
+                              const char *strtab, std::string_view /* table */) {
+        auto shdr = (const Elf64_Shdr*)entry;
+        return {idx, strtab ? std::string_view(strtab + shdr->sh_name) : std::string_view(), shdr};
+    }
+} section_ref_t;
+
+typedef struct symbol_ref_t {
+    int num = 0;
+    std::string_view name, section;
+    const Elf64_Sym *sym = nullptr;
+
+    static symbol_ref_t from(const uint8_t *entry, int idx,
+                             const char *strtab, std::string_view table) {
+        auto sym = (const Elf64_Sym*)entry;
+        return {idx, strtab ? std::string_view(strtab + sym->st_name) : std::string_view(), table, sym};
+    }
+} symbol_ref_t;
+
+typedef struct relocation_ref_t {
+    int index = 0;
+    std::string_view section;
+    const Elf64_Rela *rela = nullptr;
+
+    static relocation_ref_t from(const uint8_t *entry, int idx,
+                                 const char * /* strtab */, std::string_view table) {
+        return {idx, table, (const Elf64_Rela*)entry};
+    }
+} relocation_ref_t;
+
+typedef struct rel_ref_t {
+    int index = 0;
+    std::string_view section;
+    const Elf64_Rel *rel = nullptr;
+
+    static rel_ref_t from(const uint8_t *entry, int idx,
+                          const char * /* strtab */, std::string_view table) {
+        return {idx, table, (const Elf64_Rel*)entry};
+    }
+} rel_ref_t;
+
+/* Random-access range over a table of fixed-size entries (section headers,
+ * symbols, relocations). Dereferencing builds a Ref on the fly, so walking
+ * a table never allocates. */
+template <typename Ref>
+class Table_view {
     public:
-        Elf_parser (std::string &program_path): m_program_path{program_path} {   
-            load_memory_map();
+        class iterator {
+            public:
+                typedef std::random_access_iterator_tag iterator_category;
+                typedef Ref value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef Ref reference;
+                typedef void pointer;
+
+                iterator() = default;
+                iterator(const Table_view *view, size_t i): m_view{view}, m_i{i} {}
+
+                Ref operator*() const { return (*m_view)[m_i]; }
+                Ref operator[](difference_type n) const { return (*m_view)[m_i + n]; }
+
+                iterator &operator++() { ++m_i; return *this; }
+                iterator &operator--() { --m_i; return *this; }
+                iterator operator++(int) { auto it = *this; ++m_i; return it; }
+                iterator operator--(int) { auto it = *this; --m_i; return it; }
+                iterator &operator+=(difference_type n) { m_i += n; return *this; }
+                iterator &operator-=(difference_type n) { m_i -= n; return *this; }
+                iterator operator+(difference_type n) const { return iterator(m_view, m_i + n); }
+                iterator operator-(difference_type n) const { return iterator(m_view, m_i - n); }
+                friend iterator operator+(difference_type n, const iterator &it) { return it + n; }
+                difference_type operator-(const iterator &o) const {
+                    return (difference_type)m_i - (difference_type)o.m_i;
+                }
+
+                bool operator==(const iterator &o) const { return m_i == o.m_i; }
+                bool operator!=(const iterator &o) const { return m_i != o.m_i; }
+                bool operator<(const iterator &o) const { return m_i < o.m_i; }
+                bool operator>(const iterator &o) const { return m_i > o.m_i; }
+                bool operator<=(const iterator &o) const { return m_i <= o.m_i; }
+                bool operator>=(const iterator &o) const { return m_i >= o.m_i; }
+
+            private:
+                const Table_view *m_view = nullptr;
+                size_t m_i = 0;
+        };
+
+        Table_view() = default;
+        Table_view(const uint8_t *base, size_t count, size_t ent_size,
+                   const char *strtab, std::string_view name, int index = 0,
+                   std::shared_ptr<const void> keep_base = nullptr,
+                   std::shared_ptr<const void> keep_strtab = nullptr)
+            : m_base{base}, m_count{count}, m_ent_size{ent_size},
+              m_strtab{strtab}, m_name{name}, m_index{index},
+              m_keep_base{std::move(keep_base)}, m_keep_strtab{std::move(keep_strtab)} {}
+
+        Ref operator[](size_t i) const {
+            return Ref::from(m_base + i * m_ent_size, (int)i, m_strtab, m_name);
         }
-        std::vector<section_t> get_sections();
-        std::vector<segment_t> get_segments();
-        std::vector<symbol_t> get_symbols();
-        std::vector<relocation_t> get_relocations();
+        iterator begin() const { return iterator(this, 0); }
+        iterator end() const { return iterator(this, m_count); }
+        size_t size() const { return m_count; }
+        bool empty() const { return m_count == 0; }
+
+        /* name and index of the section holding the table */
+        std::string_view name() const { return m_name; }
+        int index() const { return m_index; }
+        /* string table entry names resolve into */
+        const char *strtab() const { return m_strtab; }
+
+    private:
+        const uint8_t *m_base = nullptr;
+        size_t m_count = 0, m_ent_size = 0;
+        const char *m_strtab = nullptr;
+        std::string_view m_name;
+        int m_index = 0;
+        // streaming mode: hold the buffers the table and names were read into
+        std::shared_ptr<const void> m_keep_base, m_keep_strtab;
+};
+
+typedef Table_view<section_ref_t> SectionView;
+typedef Table_view<symbol_ref_t> SymbolView;
+typedef Table_view<relocation_ref_t> RelocationView;
+typedef Table_view<rel_ref_t> RelView;
+
+
+/* how a file or descriptor gets mapped */
+typedef struct {
+    bool populate = false;      // MAP_POPULATE: prefault the whole file up front
+    int advice = MADV_NORMAL;   // handed to madvise(), e.g. MADV_SEQUENTIAL, MADV_WILLNEED
+
+    /* streaming mode: pread the headers once and only the sections a query
+     * touches, keeping recently used section buffers in a small LRU */
+    bool stream = false;
+    size_t stream_cache_bytes = 16 << 20;
+} map_options_t;
+
+class Pread_reader;
+
+/* Per-phase timings and counters. Only collected when the library is built
+ * with -DELF_PARSER_STATS; otherwise every field stays zero and the
+ * instrumentation compiles away. */
+typedef struct {
+    uint64_t map_ns = 0;            // mmap, or setting up the stream reader
+    uint64_t header_ns = 0;         // ELF header and header table walk
+    uint64_t strtab_ns = 0;         // string table lookup and section index
+    uint64_t symbol_decode_ns = 0;  // get_symbols()
+    uint64_t relocation_ns = 0;     // get_relocations()
+    uint64_t bytes_touched = 0;     // bytes of the file the parser asked for
+    uint64_t entries_decoded = 0;   // sections, segments, symbols, relocations
+    uint64_t allocations = 0;       // heap blocks made by the getters
+    uint64_t symbol_lookups = 0;    // get_rel_symbol_* calls
+} parse_stats_t;
+
+/* runs fn(0) .. fn(n - 1), possibly concurrently, and returns when all are
+ * done; ThreadPool::parallel_for fits */
+typedef std::function<void(size_t n, const std::function<void(size_t)> &fn)> parallel_for_t;
+
+class Elf_parser {
+    public:
+        /* all constructors throw Elf_error when the input cannot be mapped,
+         * is not ELF, or fails validation: the header tables, every section
+         * and segment and the section names are checked once here. A symbol
+         * or hash table is checked the first time it is used, which can
+         * throw too. Getters and views then read validated data unchecked. */
+        Elf_parser (const std::string &program_path,
+                    const map_options_t &options = map_options_t());
+        /* map an already open descriptor; the caller keeps ownership of fd */
+        explicit Elf_parser (int fd, const map_options_t &options = map_options_t());
+        /* parse a caller-owned buffer in place, without copying; it must
+         * outlive the parser */
+        Elf_parser (const uint8_t *data, size_t size);
+
+        /* move-only: the mapping is released when the owning parser dies */
+        Elf_parser (Elf_parser &&other) noexcept;
+        Elf_parser &operator=(Elf_parser &&other) noexcept;
+        Elf_parser (const Elf_parser &) = delete;
+        Elf_parser &operator=(const Elf_parser &) = delete;
+        ~Elf_parser();
+
+        /* non-throwing open: like the constructors, but the symbol and hash
+         * tables are checked up front too, so a malformed file is reported
+         * here rather than by a later getter */
+        static Elf_result<Elf_parser> open(const std::string &program_path,
+                                           const map_options_t &options = map_options_t()) noexcept;
+        static Elf_result<Elf_parser> open(const uint8_t *data, size_t size) noexcept;
+
+        /* decoded once on first call and shared by later calls; safe to
+         * call concurrently from several threads */
+        const std::vector<section_t> &get_sections() const;
+        const std::vector<segment_t> &get_segments() const;
+        const std::vector<symbol_t> &get_symbols() const;
+        const std::vector<relocation_t> &get_relocations() const;
+        const dynamic_info_t &get_dynamic_info() const;
+        /* EI_CLASS and EI_DATA of the input. ELF32 and opposite byte order
+         * files are rewritten into a native ELF64 image at open time, so
+         * every getter and view sees Elf64 structures either way */
+        int get_elf_class() const { return m_class; }
+        int get_elf_data() const { return m_data; }
+        uint16_t get_machine() const { return m_ehdr->e_machine; }
+        /* whole-file image; nullptr in streaming mode. For a rewritten file
+         * this is the converted image: the original bytes, with the
+         * sections listed at section_data() swapped in place, then the
+         * Elf64 tables */
         uint8_t *get_memory_map();
+        size_t get_memory_size() const { return m_program_size; }
+        /* bytes fetched with pread so far; 0 unless streaming */
+        uint64_t get_bytes_read() const;
+
+        /* opt in to decoding symbol tables of at least threshold entries in
+         * chunks through parallel_for; smaller tables stay serial. Output
+         * order is unchanged. Takes effect if set before get_symbols(). */
+        void set_parallel_decode(parallel_for_t parallel_for, size_t threshold = 1 << 16);
+
+        /* instrumentation, see parse_stats_t */
+        static bool stats_enabled();
+        parse_stats_t get_stats() const;
+        std::string get_stats_json() const;
+
+        /* render one view entry the way get_symbols() does */
+        void decode_symbol(const symbol_ref_t &sym, symbol_t &symbol) const;
+
+        /* zero-copy views over the mapped program */
+        SectionView sections() const;
+        SymbolView symbols(const section_ref_t &symtab) const;
+        RelocationView relocations(const section_ref_t &relsec) const;
+        /* SHT_REL tables, whose addends are stored at the relocated place */
+        RelView rel_relocations(const section_ref_t &relsec) const;
+
+        /* SHT_RELR: addresses of the packed relative relocations, in table
+         * order. relr_count() sizes the output; decode_relr() writes up to
+         * capacity addresses into out without allocating and returns how
+         * many it wrote */
+        size_t relr_count(const section_ref_t &relsec) const;
+        size_t decode_relr(const section_ref_t &relsec, uint64_t *out, size_t capacity) const;
+
+        /* e.g. "R_AARCH64_JUMP_SLOT" for (EM_AARCH64, 1026); nullptr for a
+         * machine or type without a table entry */
+        static const char *relocation_type_name(uint16_t machine, uint32_t type);
+
+        /* look up a defined .dynsym entry by name through .gnu.hash, then
+         * .hash, scanning the table only when neither is present */
+        std::optional<symbol_ref_t> find_dynamic_symbol(std::string_view name) const;
+
+        /* section lookup through an index built once on first use; by name
+         * the first section carrying it wins */
+        std::optional<section_ref_t> find_section(std::string_view name) const;
+        const std::vector<section_ref_t> &find_sections(uint32_t sh_type) const;
+
+        /* raw NT_GNU_BUILD_ID bytes, empty when the file has none */
+        std::string get_build_id() const;
+
+        /* compression header of an SHF_COMPRESSED section, converted from
+         * the file's class and byte order; nullopt for other sections */
+        std::optional<Elf64_Chdr> get_compression_header(const section_ref_t &sec) const;
+
+        /* bytes of a section (empty for SHT_NOBITS), or of up to size
+         * bytes at a virtual address, clipped to the PT_LOAD segment
+         * holding it. Empty when outside the file; in streaming mode keep
+         * holds the buffer they point into. They are the file's bytes in
+         * its byte order, except in a file of the opposite byte order,
+         * where these come back already swapped to host order: note
+         * headers (namesz, descsz, type; not the name or descriptor),
+         * SHT_HASH, SHT_GNU_versym and SHT_GNU_verneed, and in ELF64 files
+         * SHT_GNU_HASH and SHT_RELR as well */
+        std::string_view section_data(const section_ref_t &sec, std::shared_ptr<const void> &keep) const;
+        std::string_view address_data(uint64_t addr, uint64_t size, std::shared_ptr<const void> &keep) const;
         
     private:
-        void load_memory_map();
+        typedef struct {
+            std::once_flag index_once, sections_once, segments_once;
+            std::once_flag symbols_once, relocations_once, dynamic_once;
+            std::once_flag dynamic_info_once;
+
+            // per section: symbol names already checked against the strtab
+            std::unique_ptr<std::atomic<bool>[]> names_checked;
 
-        std::string get_section_type(int tt);
+            std::unordered_map<std::string_view, section_ref_t> by_name;
+            std::unordered_map<uint32_t, std::vector<section_ref_t>> by_type;
 
-        std::string get_segment_type(uint32_t &seg_type);
-        std::string get_segment_flags(uint32_t &seg_flags);
+            std::vector<section_t> sections;
+            std::vector<segment_t> segments;
+            std::vector<symbol_t> symbols;
+            std::vector<relocation_t> relocations;
+            dynamic_info_t dynamic_info;
 
-        std::string get_symbol_type(uint8_t &sym_type);
-        std::string get_symbol_bind(uint8_t &sym_bind);
-        std::string get_symbol_visibility(uint8_t &sym_vis);
-        std::string get_symbol_index(uint16_t &sym_idx);
+            struct {
+                std::atomic<uint64_t> map_ns{0}, header_ns{0}, strtab_ns{0};
+                std::atomic<uint64_t> symbol_decode_ns{0}, relocation_ns{0};
+                std::atomic<uint64_t> bytes_touched{0}, entries_decoded{0};
+                std::atomic<uint64_t> allocations{0}, symbol_lookups{0};
+            } stats;
 
-        std::string get_relocation_type(uint64_t &rela_type);
-        std::intptr_t get_rel_symbol_value(uint64_t &sym_idx, std::vector<symbol_t> &syms);
+            struct {
+                SymbolView dynsym;              // table the hash section indexes
+                const uint32_t *gnu_hash = nullptr, *sysv_hash = nullptr;
+                uint64_t gnu_chain_end = 0;     // one past the last chained symbol
+                std::shared_ptr<const void> keep_hash;
+            } dynamic;
+        } cache_t;
+
+        void load_memory_map(const map_options_t &options);
+        void map_fd(int fd, const map_options_t &options);
+        void open_stream(int fd, const map_options_t &options);
+        void load_headers();
+        void load_foreign();
+        void validate(uint64_t file_size);
+        void validate_tables() const;
+        void release();
+        void swap(Elf_parser &other) noexcept;
+
+        /* file bytes [offset, offset + size): points into the image when the
+         * whole file is in memory, otherwise into a buffer held by keep */
+        const uint8_t *read_bytes(uint64_t offset, uint64_t size,
+                                  std::shared_ptr<const void> &keep) const;
+        /* bytes of a symbol, relocation, dynamic or hash table in Elf64
+         * form: the converted copy for a rewritten file, else read_bytes() */
+        const uint8_t *table_bytes(const section_ref_t &sec, uint64_t &size,
+                                   std::shared_ptr<const void> &keep) const;
+        void build_section_index() const;
+
+        std::string get_section_type(int tt) const;
+
+        std::string get_segment_type(const uint32_t &seg_type) const;
+        std::string get_segment_flags(const uint32_t &seg_flags) const;
+
+        std::string get_symbol_type(const uint8_t &sym_type) const;
+        std::string get_symbol_bind(const uint8_t &sym_bind) const;
+        std::string get_symbol_visibility(const uint8_t &sym_vis) const;
+        std::string get_symbol_index(const uint16_t &sym_idx) const;
+
+        std::string get_relocation_type(const uint64_t &rela_type) const;
+        std::optional<uint64_t> dynamic_value(int64_t tag) const;
+        std::optional<uint64_t> vaddr_to_offset(uint64_t addr, uint64_t size) const;
+        std::optional<section_ref_t> plt_relocations() const;
+        std::intptr_t get_rel_symbol_value(const uint64_t &sym_idx, const SymbolView &syms) const;
         std::string get_rel_symbol_name(
-            uint64_t &sym_idx, std::vector<symbol_t> &syms);
+            const uint64_t &sym_idx, const SymbolView &syms) const;
+
+        void build_dynamic_lookup() const;
+        std::optional<symbol_ref_t> gnu_hash_lookup(const uint32_t *table, uint64_t chain_end,
+            const SymbolView &dynsym, std::string_view name) const;
+        std::optional<symbol_ref_t> sysv_hash_lookup(const uint32_t *table,
+            const SymbolView &dynsym, std::string_view name) const;
 
         std::string m_program_path; 
-        uint8_t *m_mmap_program;
+        uint8_t *m_mmap_program = nullptr;
+        size_t m_program_size = 0;
+        bool m_owns_map = false;
+        std::unique_ptr<Pread_reader> m_reader;     // streaming mode only
+        // ELF32 or foreign byte order only: the rewritten image, and per
+        // section the {offset, size} of its converted table, if any
+        std::vector<uint8_t> m_image;
+        std::vector<std::pair<uint64_t, uint64_t>> m_tables;
+        uint8_t m_class = ELFCLASSNONE, m_data = ELFDATANONE;
+
+        // header tables, resolved once at open time
+        const Elf64_Ehdr *m_ehdr = nullptr;
+        const Elf64_Phdr *m_phdr = nullptr;
+        const Elf64_Shdr *m_shdr = nullptr;
+        const char *m_shstrtab = nullptr;
+        std::shared_ptr<const void> m_keep_headers[4];
+        std::unique_ptr<cache_t> m_cache;
+
+        parallel_for_t m_parallel_for;
+        size_t m_parallel_threshold = 0;
 };
 
 }
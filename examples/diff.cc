@@ -0,0 +1,26 @@
+#include <iostream>
+#include "../elf_diff.hpp"
+
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./diff <old> <new>\n";
+    if(argc < 3) {
+        std::cerr << usage_banner;
+        return -1;
+    }
+
+    auto old_elf = elf_parser::Elf_parser::open(argv[1]);
+    auto new_elf = elf_parser::Elf_parser::open(argv[2]);
+    for (auto *elf : {&old_elf, &new_elf}) {
+        if (!*elf) {
+            std::cerr << elf->error().what() << "\n";
+            return -1;
+        }
+    }
+
+    // one JSON object per line, then the summary
+    auto summary = elf_parser::diff(*old_elf, *new_elf, [](const elf_parser::diff_entry_t &entry) {
+        printf("%s\n", elf_parser::to_json(entry).c_str());
+    });
+    printf("%s\n", elf_parser::to_json(summary).c_str());
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <filesystem>
+#include "../batch_scanner.hpp"
+
+int main(int argc, char* argv[]) {
+    char usage_banner[] = "usage: ./scan [-j <threads>] [<directory|file>...]\n";
+    if(argc < 2) {
+        std::cerr << usage_banner;
+        return -1;
+    }
+
+    size_t max_threads = std::thread::hardware_concurrency();
+    std::vector<std::string> files, dirs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if ((arg == "-j") && (i + 1 < argc)) {
+            max_threads = strtoul(argv[++i], nullptr, 0);
+            continue;
+        }
+        std::error_code ec;
+        if (std::filesystem::is_directory(arg, ec))
+            dirs.push_back(arg);
+        else
+            files.push_back(arg);
+    }
+
+    // directories are walked by the scanner itself, overlapping the walk with parsing
+    auto scan_all = [&](elf_parser::BatchScanner &scanner, const elf_parser::BatchScanner::sink_t &sink) {
+        elf_parser::scan_stats_t total = scanner.scan(files, sink);
+        for (auto &dir : dirs) {
+            auto stats = scanner.scan_directory(dir, sink);
+            total.files += stats.files;
+            total.parsed += stats.parsed;
+            total.skipped += stats.skipped;
+            total.seconds += stats.seconds;
+        }
+        return total;
+    };
+
+    // warm the page cache so the 1-thread baseline is not dominated by I/O
+    elf_parser::BatchScanner warm;
+    scan_all(warm, [](elf_parser::scan_result_t &) {});
+
+    printf("%-8s %8s %8s %8s %10s %12s %8s\n",
+           "Threads", "Files", "Parsed", "Skipped", "Symbols", "Files/sec", "Speedup");
+
+    double base_rate = 0;
+    for (size_t threads = 1; ; threads = std::min(threads * 2, max_threads)) {
+        elf_parser::scan_options_t options;
+        options.threads = threads;
+        elf_parser::BatchScanner scanner(options);
+
+        size_t nsyms = 0;
+        auto stats = scan_all(scanner, [&](elf_parser::scan_result_t &result) {
+            if (result.elf)
+                nsyms += result.elf->get_symbols().size();
+        });
+
+        double rate = stats.files / stats.seconds;
+        if (threads == 1)
+            base_rate = rate;
+        printf("%-8zu %8zu %8zu %8zu %10zu %12.0f %7.2fx\n",
+               threads, stats.files, stats.parsed, stats.skipped, nsyms, rate, rate / base_rate);
+
+        if (threads >= max_threads)
+            break;
+    }
+    return 0;
+}
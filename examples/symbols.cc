@@ -5,17 +5,25 @@
 void print_symbols(std::vector<elf_parser::symbol_t> &symbols);
 
 int main(int argc, char* argv[]) {
-    char usage_banner[] = "usage: ./sections [<executable>]\n";
+    char usage_banner[] = "usage: ./sections [<executable>] [--stats]\n";
     if(argc < 2) {
         std::cerr << usage_banner;
         return -1;
     }
 
     std::string program((std::string)argv[1]);
-    elf_parser::Elf_parser elf_parser(program);
+    bool stats = argc > 2 && std::string(argv[2]) == "--stats";
+    try {
+        elf_parser::Elf_parser elf_parser(program);
 
-    std::vector<elf_parser::symbol_t> syms = elf_parser.get_symbols();
-    print_symbols(syms);
+        std::vector<elf_parser::symbol_t> syms = elf_parser.get_symbols();
+        print_symbols(syms);
+        if (stats)
+            std::cerr << elf_parser.get_stats_json() << "\n";
+    } catch (const elf_parser::Elf_error &e) {
+        std::cerr << e.what() << "\n";
+        return -1;
+    }
     return 0;
 }
 
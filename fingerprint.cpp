@@ -0,0 +1,503 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "fingerprint.hpp"
+using namespace elf_parser;
+
+namespace {
+const size_t head_size = 4096;                  // the ELF header and, usually, phdrs and notes
+const uint64_t max_note_segment = 1 << 20;
+const uint32_t max_phdrs_size = 1 << 16;
+const unsigned char host_data =
+    (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) ? ELFDATA2LSB : ELFDATA2MSB;
+
+template <typename T> T byte_swap(T v) {
+    if constexpr (sizeof(T) == 2) return (T)__builtin_bswap16((uint16_t)v);
+    if constexpr (sizeof(T) == 4) return (T)__builtin_bswap32((uint32_t)v);
+    if constexpr (sizeof(T) == 8) return (T)__builtin_bswap64((uint64_t)v);
+    return v;
+}
+
+typedef struct {
+    uint64_t offset, size, align;
+} note_segment_t;
+
+/* one file's progress: the head read at offset 0 gives the ELF header and
+ * where the program headers are, those give the PT_NOTE segments */
+class Probe {
+    public:
+        fingerprint_t result;
+        uint64_t phoff = 0;
+        uint32_t phsize = 0;
+        std::vector<note_segment_t> segments;
+
+        /* false when there is nothing more to read: not ELF, or no phdrs */
+        bool head(const uint8_t *buf, size_t len) {
+            if ((len < EI_NIDENT) || (memcmp(buf, ELFMAG, SELFMAG) != 0)) {
+                result.error = "not an ELF file";
+                return false;
+            }
+            result.elf_class = buf[EI_CLASS];
+            result.elf_data = buf[EI_DATA];
+            result.osabi = buf[EI_OSABI];
+            result.abi_version = buf[EI_ABIVERSION];
+            if (((result.elf_class != ELFCLASS32) && (result.elf_class != ELFCLASS64)) ||
+                    ((result.elf_data != ELFDATA2LSB) && (result.elf_data != ELFDATA2MSB))) {
+                result.error = "unsupported ELF class or byte order";
+                return false;
+            }
+            m_swap = result.elf_data != host_data;
+            bool ok = (result.elf_class == ELFCLASS64) ? ehdr<Elf64_Ehdr, Elf64_Phdr>(buf, len)
+                                                       : ehdr<Elf32_Ehdr, Elf32_Phdr>(buf, len);
+            return ok && (phsize > 0);
+        }
+
+        bool phdrs_in(size_t len) const { return phoff + phsize <= len; }
+
+        void phdrs(const uint8_t *buf) {
+            if (result.elf_class == ELFCLASS64)
+                note_segments<Elf64_Phdr>(buf);
+            else
+                note_segments<Elf32_Phdr>(buf);
+        }
+
+        /* GNU notes pad the name and descriptor to the segment alignment,
+         * counted from the start of the note */
+        void notes(const uint8_t *buf, uint64_t size, uint64_t align) {
+            align = (align == 8) ? 8 : 4;
+            auto pad = [align](uint64_t n) { return (n + align - 1) & ~(align - 1); };
+            uint64_t pos = 0;
+            // pos can land past size after the last descriptor's padding
+            while (pos + 12 <= size) {
+                uint32_t namesz = get<uint32_t>(buf + pos), descsz = get<uint32_t>(buf + pos + 4);
+                uint32_t type = get<uint32_t>(buf + pos + 8);
+                uint64_t desc = pos + pad(12 + (uint64_t)namesz);
+                if ((desc > size) || (descsz > size - desc))
+                    break;
+                note_t note;
+                note.name.assign((const char*)buf + pos + 12, strnlen((const char*)buf + pos + 12, namesz));
+                note.type = type;
+                note.desc.assign((const char*)buf + desc, descsz);
+                if (note.name == "GNU") {
+                    if ((type == NT_GNU_BUILD_ID) && result.build_id.empty())
+                        result.build_id = note.desc;
+                    if ((type == NT_GNU_ABI_TAG) && (descsz >= 16)) {
+                        result.abi_os = get<uint32_t>(buf + desc);
+                        for (int i = 0; i < 3; ++i)
+                            result.abi_kernel[i] = get<uint32_t>(buf + desc + 4 * (i + 1));
+                    }
+                }
+                result.notes.push_back(std::move(note));
+                pos = desc + pad(descsz);
+            }
+        }
+
+    private:
+        template <typename T> T get(const uint8_t *p) const {
+            T v;
+            memcpy(&v, p, sizeof(T));
+            return m_swap ? byte_swap(v) : v;
+        }
+        template <typename T> T fix(T v) const { return m_swap ? byte_swap(v) : v; }
+
+        template <typename Ehdr, typename Phdr> bool ehdr(const uint8_t *buf, size_t len) {
+            if (len < sizeof(Ehdr)) {
+                result.error = "truncated ELF header";
+                return false;
+            }
+            Ehdr e;
+            memcpy(&e, buf, sizeof(e));
+            result.type = fix(e.e_type);
+            result.machine = fix(e.e_machine);
+            result.flags = fix(e.e_flags);
+            result.entry = fix(e.e_entry);
+            result.phnum = fix(e.e_phnum);
+            result.shnum = fix(e.e_shnum);
+            phoff = fix(e.e_phoff);
+            if ((result.phnum > 0) && (result.phnum != PN_XNUM) &&
+                    (fix(e.e_phentsize) == sizeof(Phdr)) &&
+                    ((uint64_t)result.phnum * sizeof(Phdr) <= max_phdrs_size))
+                phsize = result.phnum * sizeof(Phdr);
+            return true;
+        }
+
+        template <typename Phdr> void note_segments(const uint8_t *buf) {
+            for (uint32_t off = 0; off < phsize; off += sizeof(Phdr)) {
+                Phdr p;
+                memcpy(&p, buf + off, sizeof(p));
+                if ((fix(p.p_type) == PT_NOTE) && (fix(p.p_filesz) > 0) &&
+                        (fix(p.p_filesz) <= max_note_segment))
+                    segments.push_back({fix(p.p_offset), fix(p.p_filesz), fix(p.p_align)});
+            }
+        }
+
+        bool m_swap = false;
+};
+
+ssize_t pread_full(int fd, uint8_t *buf, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, buf + done, size - done, offset + done);
+        if ((n < 0) && (errno == EINTR))
+            continue;
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+}
+
+fingerprint_t elf_parser::fingerprint(int fd) {
+    Probe probe;
+    uint8_t head[head_size];
+    ssize_t len = pread_full(fd, head, head_size, 0);
+    if (len < 0) {
+        probe.result.error = strerror(errno);
+        return probe.result;
+    }
+    if (!probe.head(head, len))
+        return probe.result;
+
+    std::vector<uint8_t> buf;
+    if (probe.phdrs_in(len)) {
+        probe.phdrs(head + probe.phoff);
+    } else {
+        buf.resize(probe.phsize);
+        if (pread_full(fd, buf.data(), probe.phsize, probe.phoff) != (ssize_t)probe.phsize) {
+            probe.result.error = "truncated program headers";
+            return probe.result;
+        }
+        probe.phdrs(buf.data());
+    }
+    for (auto &seg : probe.segments) {
+        if ((seg.offset <= (uint64_t)len) && (seg.size <= len - seg.offset)) {
+            probe.notes(head + seg.offset, seg.size, seg.align);
+            continue;
+        }
+        buf.resize(seg.size);
+        if (pread_full(fd, buf.data(), seg.size, seg.offset) == (ssize_t)seg.size)
+            probe.notes(buf.data(), seg.size, seg.align);
+    }
+    return probe.result;
+}
+
+fingerprint_t elf_parser::fingerprint(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fingerprint_t result;
+        result.error = strerror(errno);
+        return result;
+    }
+    fingerprint_t result = fingerprint(fd);
+    close(fd);
+    return result;
+}
+
+/* a minimal io_uring over the raw syscalls: one submission and one
+ * completion ring, mapped at construction */
+class Fingerprinter::Ring {
+    public:
+        explicit Ring(unsigned entries) {
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            m_fd = syscall(__NR_io_uring_setup, entries, &params);
+            if (m_fd < 0)
+                return;
+            if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !supported()) {
+                release();
+                return;
+            }
+            m_ring_size = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                                   params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+            m_ring = mmap(nullptr, m_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          m_fd, IORING_OFF_SQ_RING);
+            m_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            m_sqes = (io_uring_sqe*)mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE,
+                                         MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+            if ((m_ring == MAP_FAILED) || (m_sqes == MAP_FAILED)) {
+                release();
+                return;
+            }
+            auto *base = (uint8_t*)m_ring;
+            m_sq_head = (unsigned*)(base + params.sq_off.head);
+            m_sq_tail = (unsigned*)(base + params.sq_off.tail);
+            m_sq_mask = *(unsigned*)(base + params.sq_off.ring_mask);
+            m_sq_entries = params.sq_entries;
+            m_cq_head = (unsigned*)(base + params.cq_off.head);
+            m_cq_tail = (unsigned*)(base + params.cq_off.tail);
+            m_cq_mask = *(unsigned*)(base + params.cq_off.ring_mask);
+            m_cqes = (io_uring_cqe*)(base + params.cq_off.cqes);
+            // submission slots map one to one onto sqes
+            auto *array = (unsigned*)(base + params.sq_off.array);
+            for (unsigned i = 0; i < m_sq_entries; ++i)
+                array[i] = i;
+            m_tail = *m_sq_tail;
+        }
+
+        ~Ring() { release(); }
+
+        bool ok() const { return m_fd >= 0; }
+
+        io_uring_sqe *get_sqe() {
+            while (m_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries)
+                enter(0);
+            io_uring_sqe *sqe = &m_sqes[m_tail & m_sq_mask];
+            memset(sqe, 0, sizeof(*sqe));
+            ++m_tail;
+            ++m_to_submit;
+            return sqe;
+        }
+
+        /* hand queued sqes to the kernel and wait for at least wait
+         * completions */
+        void enter(unsigned wait) {
+            __atomic_store_n(m_sq_tail, m_tail, __ATOMIC_RELEASE);
+            for (;;) {
+                int n = syscall(__NR_io_uring_enter, m_fd, m_to_submit, wait,
+                                wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+                if (n >= 0) {
+                    m_to_submit -= std::min<unsigned>(n, m_to_submit);
+                    return;
+                }
+                // completions backed up: let the caller reap them first
+                if ((errno == EAGAIN) || (errno == EBUSY))
+                    return;
+                if (errno != EINTR)
+                    throw Elf_error(std::string("Err: io_uring_enter: ") + strerror(errno), Elf_errc::io);
+            }
+        }
+
+        template <typename Fn> void reap(Fn &&fn) {
+            unsigned head = *m_cq_head, tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                io_uring_cqe cqe = m_cqes[head & m_cq_mask];
+                __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+                fn(cqe.user_data, cqe.res);
+            }
+        }
+
+    private:
+        /* openat, read and close need Linux 5.6 */
+        bool supported() const {
+            size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+            std::vector<uint8_t> buf(size);
+            auto *probe = (io_uring_probe*)buf.data();
+            if (syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+                return false;
+            for (int op : {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE})
+                if ((op > probe->last_op) || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+                    return false;
+            return true;
+        }
+
+        void release() {
+            if (m_sqes && (m_sqes != MAP_FAILED))
+                munmap(m_sqes, m_sqes_size);
+            if (m_ring && (m_ring != MAP_FAILED))
+                munmap(m_ring, m_ring_size);
+            if (m_fd >= 0)
+                close(m_fd);
+            m_fd = -1;
+            m_ring = nullptr;
+            m_sqes = nullptr;
+        }
+
+        int m_fd = -1;
+        void *m_ring = nullptr;
+        size_t m_ring_size = 0, m_sqes_size = 0;
+        io_uring_sqe *m_sqes = nullptr;
+        unsigned *m_sq_head = nullptr, *m_sq_tail = nullptr, *m_cq_head = nullptr, *m_cq_tail = nullptr;
+        unsigned m_sq_mask = 0, m_sq_entries = 0, m_cq_mask = 0;
+        io_uring_cqe *m_cqes = nullptr;
+        unsigned m_tail = 0, m_to_submit = 0;
+};
+
+Fingerprinter::Fingerprinter(const fingerprint_options_t &options) : m_options{options} {
+    if (m_options.queue_depth == 0)
+        m_options.queue_depth = 1;
+    if (m_options.io_uring) {
+        // a file has at most a few reads in flight besides its open and close
+        m_ring.reset(new Ring(4 * m_options.queue_depth));
+        if (!m_ring->ok())
+            m_ring.reset();
+    }
+    if (!m_ring)
+        m_pool.reset(new ThreadPool(std::max<size_t>(m_options.threads, 1)));
+}
+
+Fingerprinter::~Fingerprinter() = default;
+
+std::vector<fingerprint_t> Fingerprinter::run(const std::vector<std::string> &paths) {
+    std::vector<fingerprint_t> out(paths.size());
+    if (m_ring)
+        run_ring(paths, out);
+    else
+        m_pool->parallel_for(paths.size(), [&](size_t i) { out[i] = fingerprint(paths[i]); });
+    return out;
+}
+
+/* each file in flight owns a slot and moves through open, head read,
+ * program header read (rarely needed), note reads, then close. user_data
+ * carries slot << 16 | note << 4 | op */
+void Fingerprinter::run_ring(const std::vector<std::string> &paths, std::vector<fingerprint_t> &out) {
+    enum { op_open = 1, op_head, op_phdrs, op_note, op_close };
+    typedef struct {
+        size_t index;
+        int fd = -1;
+        Probe probe;
+        std::vector<uint8_t> head, phdrs;
+        std::vector<std::vector<uint8_t>> notes;
+        size_t head_len = 0, pending = 0;
+    } slot_t;
+
+    std::vector<slot_t> slots(m_options.queue_depth);
+    std::vector<size_t> free_slots;
+    for (size_t i = slots.size(); i-- > 0; )
+        free_slots.push_back(i);
+    size_t next = 0, closing = 0;
+
+    auto queue_read = [&](size_t s, uint8_t *buf, size_t size, uint64_t offset, uint64_t op) {
+        io_uring_sqe *sqe = m_ring->get_sqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = slots[s].fd;
+        sqe->addr = (uint64_t)buf;
+        sqe->len = size;
+        sqe->off = offset;
+        sqe->user_data = s << 16 | op;
+    };
+    auto finish = [&](size_t s) {
+        slot_t &slot = slots[s];
+        out[slot.index] = std::move(slot.probe.result);
+        if (slot.fd >= 0) {
+            io_uring_sqe *sqe = m_ring->get_sqe();
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = slot.fd;
+            sqe->user_data = op_close;
+            ++closing;
+        }
+        free_slots.push_back(s);
+    };
+    auto read_notes = [&](size_t s) {
+        slot_t &slot = slots[s];
+        auto &segs = slot.probe.segments;
+        slot.notes.resize(segs.size());
+        for (size_t k = 0; k < segs.size(); ++k) {
+            if ((segs[k].offset <= slot.head_len) && (segs[k].size <= slot.head_len - segs[k].offset))
+                continue;
+            slot.notes[k].resize(segs[k].size);
+            queue_read(s, slot.notes[k].data(), segs[k].size, segs[k].offset, k << 4 | op_note);
+            ++slot.pending;
+        }
+    };
+    // all reads are in: parse the notes in segment order
+    auto parse_notes = [&](size_t s) {
+        slot_t &slot = slots[s];
+        auto &segs = slot.probe.segments;
+        for (size_t k = 0; k < segs.size(); ++k) {
+            if (!slot.notes[k].empty())
+                slot.probe.notes(slot.notes[k].data(), segs[k].size, segs[k].align);
+            else if ((segs[k].offset <= slot.head_len) && (segs[k].size <= slot.head_len - segs[k].offset))
+                slot.probe.notes(slot.head.data() + segs[k].offset, segs[k].size, segs[k].align);
+        }
+        finish(s);
+    };
+    auto fail = [&](size_t s, int res) {
+        slots[s].probe.result.error = strerror(-res);
+        finish(s);
+    };
+
+    while ((next < paths.size()) || (free_slots.size() < slots.size()) || closing) {
+        while ((next < paths.size()) && !free_slots.empty()) {
+            size_t s = free_slots.back();
+            free_slots.pop_back();
+            slot_t &slot = slots[s];
+            slot.index = next;
+            slot.fd = -1;
+            slot.probe = Probe();
+            slot.head.resize(head_size);
+            slot.notes.clear();
+            slot.pending = 0;
+            io_uring_sqe *sqe = m_ring->get_sqe();
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = AT_FDCWD;
+            sqe->addr = (uint64_t)paths[next].c_str();
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data = s << 16 | op_open;
+            ++next;
+        }
+        m_ring->enter(1);
+        m_ring->reap([&](uint64_t data, int res) {
+            size_t s = data >> 16, op = data & 0xf, note = (data >> 4) & 0xfff;
+            slot_t &slot = slots[s];
+            switch (op) {
+                case op_open:
+                    if (res < 0)
+                        return fail(s, res);
+                    slot.fd = res;
+                    queue_read(s, slot.head.data(), head_size, 0, op_head);
+                    return;
+                case op_head:
+                    if (res < 0)
+                        return fail(s, res);
+                    slot.head_len = res;
+                    if (!slot.probe.head(slot.head.data(), res))
+                        return finish(s);
+                    if (!slot.probe.phdrs_in(res)) {
+                        slot.phdrs.resize(slot.probe.phsize);
+                        queue_read(s, slot.phdrs.data(), slot.probe.phsize, slot.probe.phoff, op_phdrs);
+                        return;
+                    }
+                    slot.probe.phdrs(slot.head.data() + slot.probe.phoff);
+                    break;
+                case op_phdrs:
+                    if (res != (int)slot.probe.phsize) {
+                        slot.probe.result.error = "truncated program headers";
+                        return finish(s);
+                    }
+                    slot.probe.phdrs(slot.phdrs.data());
+                    break;
+                case op_note:
+                    if (res != (int)slot.notes[note].size())
+                        slot.notes[note].clear();       // short read: skip the segment
+                    if (--slot.pending == 0)
+                        parse_notes(s);
+                    return;
+                case op_close:
+                    --closing;
+                    return;
+            }
+            // the program headers are in: fetch the notes outside the head
+            read_notes(s);
+            if (slot.pending == 0)
+                parse_notes(s);
+        });
+    }
+}
@@ -0,0 +1,96 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_FINGERPRINT
+#define H_FINGERPRINT
+
+#include "elf_parser.hpp"
+#include "thread_pool.hpp"
+
+namespace elf_parser {
+
+/* one entry of a PT_NOTE segment */
+typedef struct {
+    std::string name;       // owner, e.g. "GNU"
+    uint32_t type = 0;
+    std::string desc;       // raw descriptor, in the file's byte order
+} note_t;
+
+/* the ELF header fields and PT_NOTE contents of a file, read without
+ * mapping it. ELF32 and big-endian files are decoded as well */
+typedef struct {
+    std::string error;                  // empty on success
+    int elf_class = 0, elf_data = 0;    // EI_CLASS, EI_DATA
+    uint8_t osabi = 0, abi_version = 0;
+    uint16_t type = 0, machine = 0;
+    uint32_t flags = 0;
+    uint64_t entry = 0;
+    uint16_t phnum = 0, shnum = 0;
+    std::string build_id;               // raw NT_GNU_BUILD_ID bytes
+    /* NT_GNU_ABI_TAG: ELF_NOTE_OS_* (-1 without the note) and the
+     * minimum kernel version */
+    int abi_os = -1;
+    uint32_t abi_kernel[3] = {0, 0, 0};
+    std::vector<note_t> notes;
+} fingerprint_t;
+
+/* read the ELF header, program headers and PT_NOTE segments with a few
+ * preads: usually one, as they sit in the first page. Never throws; a
+ * file that is not ELF or cannot be read comes back with error set */
+fingerprint_t fingerprint(const std::string &path);
+fingerprint_t fingerprint(int fd);
+
+typedef struct {
+    size_t threads = std::thread::hardware_concurrency();   // thread pool fallback
+    size_t queue_depth = 64;    // files in flight on the io_uring path
+    bool io_uring = true;       // false always uses the thread pool
+} fingerprint_options_t;
+
+/* fingerprint() for many files. Where the kernel allows it, the opens,
+ * reads and closes of queue_depth files at a time go through one io_uring
+ * driven from the calling thread, so a batch costs a few syscalls per
+ * queue_depth files. Otherwise the files are spread over a thread pool. */
+class Fingerprinter {
+    public:
+        explicit Fingerprinter(const fingerprint_options_t &options = fingerprint_options_t());
+        ~Fingerprinter();
+
+        Fingerprinter(const Fingerprinter &) = delete;
+        Fingerprinter &operator=(const Fingerprinter &) = delete;
+
+        /* results are in input order */
+        std::vector<fingerprint_t> run(const std::vector<std::string> &paths);
+
+        bool uses_io_uring() const { return m_ring != nullptr; }
+
+    private:
+        class Ring;
+
+        void run_ring(const std::vector<std::string> &paths, std::vector<fingerprint_t> &out);
+
+        fingerprint_options_t m_options;
+        std::unique_ptr<Ring> m_ring;
+        std::unique_ptr<ThreadPool> m_pool;
+};
+
+}
+#endif
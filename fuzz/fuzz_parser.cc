@@ -0,0 +1,49 @@
+// libFuzzer entry point over the parser: every input goes through the
+// non-throwing open, and a file that validates is walked through each
+// getter and view. Crashes, sanitizer reports and escaping exceptions
+// are the findings.
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "../elf_parser.hpp"
+
+using namespace elf_parser;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    // the parser reads the buffer in place through Elf64 structures; give
+    // it the alignment a mapping would have
+    std::vector<uint64_t> copy((size + 7) / 8);
+    if (size)
+        memcpy(copy.data(), data, size);
+
+    auto elf = Elf_parser::open((const uint8_t*)copy.data(), size);
+    if (!elf)
+        return 0;
+
+    elf->get_sections();
+    elf->get_segments();
+    elf->get_symbols();
+    elf->get_relocations();
+    elf->get_dynamic_info();
+    elf->get_build_id();
+    elf->find_dynamic_symbol("main");
+    elf->find_section(".text");
+
+    std::shared_ptr<const void> keep;
+    for (auto sec : elf->sections()) {
+        elf->get_compression_header(sec);
+        elf->section_data(sec, keep);
+        switch (sec.header->sh_type) {
+            case SHT_SYMTAB: case SHT_DYNSYM:
+                for (auto sym : elf->symbols(sec))
+                    elf->address_data(sym.sym->st_value, sym.sym->st_size, keep);
+                break;
+            case SHT_RELR: {
+                std::vector<uint64_t> addrs(elf->relr_count(sec));
+                elf->decode_relr(sec, addrs.data(), addrs.size());
+                break;
+            }
+        }
+    }
+    return 0;
+}
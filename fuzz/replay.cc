@@ -0,0 +1,43 @@
+// Runs the fuzz target over saved inputs without libFuzzer, for compilers
+// that lack -fsanitize=fuzzer and for replaying a corpus or a crash:
+//   ./replay corpus/ crash-1234
+#include <cstdio>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static size_t run(const std::string &path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) < 0)
+        return 0;
+    if (S_ISDIR(st.st_mode)) {
+        size_t n = 0;
+        if (DIR *dir = opendir(path.c_str())) {
+            while (struct dirent *entry = readdir(dir)) {
+                if (entry->d_name[0] != '.')
+                    n += run(path + "/" + entry->d_name);
+            }
+            closedir(dir);
+        }
+        return n;
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    size_t n = 0;
+    for (int i = 1; i < argc; ++i)
+        n += run(argv[i]);
+    fprintf(stderr, "replayed %zu inputs\n", n);
+    return 0;
+}
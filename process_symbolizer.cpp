@@ -0,0 +1,348 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <cinttypes>
+#include <sys/sysmacros.h>
+#include "process_symbolizer.hpp"
+using namespace elf_parser;
+
+static bool read_maps(pid_t pid, std::string &text) {
+    std::string path = "/proc/" + std::to_string(pid) + "/maps";
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    char buf[65536];
+    for (;;) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if ((n < 0) && (errno == EINTR))
+            continue;
+        if (n <= 0) {
+            close(fd);
+            return n == 0;
+        }
+        text.append(buf, n);
+    }
+}
+
+// "start-end perms offset major:minor inode path", keeping file-backed lines
+static std::vector<process_mapping_t> parse_maps(const std::string &text) {
+    static const std::string deleted = " (deleted)";
+    std::vector<process_mapping_t> mappings;
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t eol = std::min(text.find('\n', pos), text.size());
+        std::string line = text.substr(pos, eol - pos);
+        pos = eol + 1;
+
+        process_mapping_t mapping;
+        char perms[5] = {};
+        unsigned major, minor;
+        unsigned long long ino;
+        int path_at = 0;
+        if ((sscanf(line.c_str(), "%" SCNx64 "-%" SCNx64 " %4s %" SCNx64 " %x:%x %llu %n",
+                    &mapping.start, &mapping.end, perms, &mapping.offset,
+                    &major, &minor, &ino, &path_at) < 7) || !ino || !path_at)
+            continue;
+
+        mapping.path = line.substr(path_at);
+        if (mapping.path.empty())
+            continue;
+        if ((mapping.path.size() > deleted.size()) &&
+                !mapping.path.compare(mapping.path.size() - deleted.size(), deleted.size(), deleted)) {
+            mapping.path.resize(mapping.path.size() - deleted.size());
+            mapping.deleted = true;
+        }
+        mapping.dev = makedev(major, minor);
+        mapping.ino = ino;
+        mapping.exec = perms[2] == 'x';
+        mappings.push_back(std::move(mapping));
+    }
+    return mappings;
+}
+
+std::vector<process_mapping_t> elf_parser::read_process_maps(pid_t pid) {
+    std::string text;
+    if (!read_maps(pid, text))
+        return {};
+    return parse_maps(text);
+}
+
+std::shared_ptr<const mapped_object_t> ParserCache::get(dev_t dev, ino_t ino,
+                                                        const std::vector<std::string> &paths) {
+    std::shared_ptr<entry_t> entry;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        auto &slot = m_entries[{dev, ino}];
+        entry = slot.lock();
+        if (!entry) {
+            entry = std::make_shared<entry_t>();
+            slot = entry;
+        }
+        if (m_entries.size() > m_sweep_at) {
+            std::erase_if(m_entries, [](auto &item) { return item.second.expired(); });
+            m_sweep_at = std::max<size_t>(64, 2 * m_entries.size());
+        }
+    }
+
+    std::call_once(entry->once, [&] {
+        mapped_object_t &object = entry->object;
+        object.dev = dev;
+        object.ino = ino;
+        object.error = "cannot open file";
+        // a path that cannot be opened is skipped; the first that opens is
+        // the object, usable or not
+        for (auto &path : paths) {
+            auto elf = Elf_parser::open(path);
+            if (!elf && (elf.error().code() == Elf_errc::io)) {
+                object.error = elf.error().what();
+                continue;
+            }
+            ++m_parsed;
+            object.path = path;
+            if (!elf) {
+                object.error = elf.error().what();
+                break;
+            }
+            object.error.clear();
+            object.elf.reset(new Elf_parser(std::move(*elf)));
+            // symbol tables are validated as the resolver reads them; a
+            // corrupt one leaves the object unusable instead of escaping
+            // into a pool worker
+            try {
+                object.resolver.reset(new SymbolResolver(*object.elf));
+            } catch (const Elf_error &e) {
+                object.error = e.what();
+                object.elf.reset();
+                break;
+            }
+            for (auto &segment : object.elf->get_segments()) {
+                if (segment.segment_type == "LOAD")
+                    object.loads.push_back(segment);
+            }
+            break;
+        }
+    });
+    // the object shares the entry's reference count
+    return std::shared_ptr<const mapped_object_t>(entry, &entry->object);
+}
+
+size_t ParserCache::size() {
+    std::lock_guard<std::mutex> guard(m_lock);
+    std::erase_if(m_entries, [](auto &item) { return item.second.expired(); });
+    return m_entries.size();
+}
+
+ProcessSymbolizer::ProcessSymbolizer(ParserCache &cache, ThreadPool *pool)
+    : m_cache{cache}, m_pool{pool} {}
+
+std::shared_ptr<const ProcessSymbolizer::process_t> ProcessSymbolizer::snapshot(pid_t pid) const {
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = m_processes.find(pid);
+    return (it == m_processes.end()) ? nullptr : it->second;
+}
+
+bool ProcessSymbolizer::scan(pid_t pid) {
+    std::string text;
+    if (!read_maps(pid, text)) {
+        forget(pid);
+        return false;
+    }
+    auto previous = snapshot(pid);
+    if (previous && (previous->maps == text)) {
+        ++m_unchanged;
+        return true;
+    }
+
+    auto process = std::make_shared<process_t>();
+    auto mappings = parse_maps(text);
+    process->maps = std::move(text);
+    process->regions.reserve(mappings.size());
+
+    // both lists are in address order: walk them side by side and keep
+    // what did not change
+    size_t j = 0;
+    for (auto &mapping : mappings) {
+        region_t region;
+        region.mapping = std::move(mapping);
+        auto &m = region.mapping;
+
+        const region_t *old = nullptr;
+        if (previous) {
+            auto &olds = previous->regions;
+            while ((j < olds.size()) && (olds[j].mapping.start < m.start))
+                ++j;
+            if (j < olds.size()) {
+                auto &o = olds[j].mapping;
+                if ((o.start == m.start) && (o.end == m.end) && (o.offset == m.offset) &&
+                        (o.dev == m.dev) && (o.ino == m.ino) && (o.path == m.path))
+                    old = &olds[j];
+            }
+        }
+        if (old) {
+            region.object = old->object;
+            region.bias = old->bias;
+            region.usable = old->usable;
+            ++m_reused;
+        } else {
+            locate(pid, region);
+            ++m_added;
+        }
+        process->regions.push_back(std::move(region));
+    }
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_processes[pid] = std::move(process);
+    return true;
+}
+
+size_t ProcessSymbolizer::scan(std::span<const pid_t> pids) {
+    std::atomic<size_t> found{0};
+    auto one = [&](size_t i) {
+        if (scan(pids[i]))
+            ++found;
+    };
+    if (m_pool && (pids.size() > 1)) {
+        m_pool->parallel_for(pids.size(), one);
+    } else {
+        for (size_t i = 0; i < pids.size(); ++i)
+            one(i);
+    }
+    return found;
+}
+
+void ProcessSymbolizer::forget(pid_t pid) {
+    std::shared_ptr<const process_t> process;
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = m_processes.find(pid);
+    if (it == m_processes.end())
+        return;
+    // released outside the lock
+    process = std::move(it->second);
+    m_processes.erase(it);
+}
+
+void ProcessSymbolizer::locate(pid_t pid, region_t &region) {
+    auto &m = region.mapping;
+
+    // the path may since name another file, or another mount namespace's
+    std::vector<std::string> paths;
+    struct stat st;
+    if (!m.deleted && (stat(m.path.c_str(), &st) == 0) && (st.st_dev == m.dev) && (st.st_ino == m.ino))
+        paths.push_back(m.path);
+    char range[64];
+    snprintf(range, sizeof(range), "/map_files/%" PRIx64 "-%" PRIx64, m.start, m.end);
+    std::string proc = "/proc/" + std::to_string(pid);
+    paths.push_back(proc + range);
+    if (!m.deleted)
+        paths.push_back(proc + "/root" + m.path);
+
+    region.object = m_cache.get(m.dev, m.ino, paths);
+    if (!region.object->elf)
+        return;
+
+    // the PT_LOAD whose page-aligned file range holds the mapped offset
+    static const uint64_t page = sysconf(_SC_PAGESIZE);
+    for (auto &load : region.object->loads) {
+        uint64_t offset = load.segment_offset;
+        if ((m.offset < (offset & ~(page - 1))) || (m.offset >= offset + load.segment_filesize))
+            continue;
+        region.bias = m.start - m.offset + offset - (uint64_t)load.segment_virtaddr;
+        region.usable = true;
+        return;
+    }
+}
+
+const ProcessSymbolizer::region_t *ProcessSymbolizer::find(const process_t &process, uint64_t addr) {
+    auto &regions = process.regions;
+    auto it = std::upper_bound(regions.begin(), regions.end(), addr,
+        [](uint64_t a, const region_t &region) { return a < region.mapping.start; });
+    if (it == regions.begin())
+        return nullptr;
+    --it;
+    return ((addr < it->mapping.end) && it->usable) ? &*it : nullptr;
+}
+
+std::pair<std::shared_ptr<const mapped_object_t>, uint64_t>
+ProcessSymbolizer::translate(pid_t pid, uint64_t addr) const {
+    if (auto process = snapshot(pid)) {
+        if (auto *region = find(*process, addr))
+            return {region->object, addr - region->bias};
+    }
+    return {nullptr, 0};
+}
+
+symbolized_t ProcessSymbolizer::resolve(pid_t pid, std::span<const uint64_t> pcs) const {
+    symbolized_t result;
+    result.pid = pid;
+    result.frames.resize(pcs.size());
+    auto process = snapshot(pid);
+    if (!process)
+        return result;
+    result.keep = process;
+
+    // group by object, so that each resolver merges one sorted batch
+    std::unordered_map<const mapped_object_t*, std::vector<uint32_t>> groups;
+    for (size_t i = 0; i < pcs.size(); ++i) {
+        auto *region = find(*process, pcs[i]);
+        if (!region)
+            continue;
+        auto &frame = result.frames[i];
+        frame.object = region->object.get();
+        frame.vaddr = pcs[i] - region->bias;
+        groups[frame.object].push_back(i);
+    }
+
+    std::vector<uint64_t> vaddrs;
+    for (auto &group : groups) {
+        auto &resolver = *group.first->resolver;
+        auto &indices = group.second;
+        if (indices.size() == 1) {
+            auto &frame = result.frames[indices[0]];
+            frame.symbol = resolver.resolve(frame.vaddr);
+            continue;
+        }
+        vaddrs.clear();
+        for (auto i : indices)
+            vaddrs.push_back(result.frames[i].vaddr);
+        auto symbols = resolver.resolve(std::span<const uint64_t>(vaddrs));
+        for (size_t k = 0; k < indices.size(); ++k)
+            result.frames[indices[k]].symbol = symbols[k];
+    }
+    return result;
+}
+
+std::vector<symbolized_t> ProcessSymbolizer::resolve(std::span<const pc_batch_t> batches) const {
+    std::vector<symbolized_t> results(batches.size());
+    auto one = [&](size_t i) {
+        results[i] = resolve(batches[i].pid, batches[i].pcs);
+    };
+    if (m_pool && (batches.size() > 1)) {
+        m_pool->parallel_for(batches.size(), one);
+    } else {
+        for (size_t i = 0; i < batches.size(); ++i)
+            one(i);
+    }
+    return results;
+}
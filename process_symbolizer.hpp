@@ -0,0 +1,176 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_PROCESS_SYMBOLIZER
+#define H_PROCESS_SYMBOLIZER
+
+#include <map>
+#include <span>
+#include <sys/types.h>
+#include "elf_parser.hpp"
+#include "symbol_resolver.hpp"
+#include "thread_pool.hpp"
+
+namespace elf_parser {
+
+/* one file-backed line of /proc/<pid>/maps */
+typedef struct {
+    uint64_t start = 0, end = 0;    // [start, end) in the process
+    uint64_t offset = 0;            // file offset mapped at start
+    dev_t dev = 0;
+    ino_t ino = 0;
+    bool exec = false;
+    bool deleted = false;           // the file was unlinked or replaced
+    std::string path;               // without the " (deleted)" suffix
+} process_mapping_t;
+
+/* file-backed mappings of a process, in address order; empty when the
+ * process is gone or its maps cannot be read */
+std::vector<process_mapping_t> read_process_maps(pid_t pid);
+
+/* an ELF file as processes map it, parsed once */
+typedef struct {
+    std::string path;               // as opened
+    dev_t dev = 0;
+    ino_t ino = 0;
+    std::unique_ptr<Elf_parser> elf;
+    std::unique_ptr<SymbolResolver> resolver;
+    std::vector<segment_t> loads;   // the PT_LOAD entries of get_segments()
+    std::string error;              // set when the file is not a usable ELF file
+} mapped_object_t;
+
+/* Parsed objects keyed by device and inode, so every process mapping a
+ * library shares one parse. An entry lives for as long as someone holds
+ * it, a process snapshot or a caller, and is dropped with the last
+ * reference. Safe to use from several threads; concurrent requests for the
+ * same file wait for one parse. */
+class ParserCache {
+    public:
+        /* the object for (dev, ino), parsed on first use from the first of
+         * paths that can be opened */
+        std::shared_ptr<const mapped_object_t> get(dev_t dev, ino_t ino,
+                                                   const std::vector<std::string> &paths);
+
+        /* objects currently held by someone */
+        size_t size();
+        /* files parsed so far */
+        size_t parsed() const { return m_parsed; }
+
+    private:
+        typedef struct {
+            std::once_flag once;
+            mapped_object_t object;
+        } entry_t;
+
+        std::mutex m_lock;
+        std::map<std::pair<dev_t, ino_t>, std::weak_ptr<entry_t>> m_entries;
+        size_t m_sweep_at = 64;     // drop expired entries once the map grows past this
+        std::atomic<size_t> m_parsed{0};
+};
+
+/* a runtime address, located */
+typedef struct {
+    const mapped_object_t *object = nullptr;    // null outside any mapped ELF file
+    uint64_t vaddr = 0;                         // the address in the file's virtual addresses
+    resolution_t symbol;                        // symbol_name points into object
+} frame_t;
+
+/* frames for a batch of addresses of one process, in input order */
+typedef struct {
+    pid_t pid = 0;
+    std::vector<frame_t> frames;
+    std::shared_ptr<const void> keep;           // holds the objects frames point into
+} symbolized_t;
+
+typedef struct {
+    pid_t pid = 0;
+    std::span<const uint64_t> pcs;
+} pc_batch_t;
+
+/* Symbolizes addresses of live processes.
+ *
+ * scan() reads /proc/<pid>/maps and takes each mapped file from a
+ * ParserCache. A mapping's load bias comes from the PT_LOAD entry covering
+ * its file offset; an address minus the bias is the file's virtual address,
+ * which the object's SymbolResolver resolves. Rescans are incremental:
+ * unchanged maps are not parsed again, an unchanged mapping keeps its
+ * object and bias, and only files new to the cache get parsed, e.g. after
+ * a dlopen(). Files are opened by path when it still names the mapped
+ * inode, else through /proc/<pid>/map_files or /proc/<pid>/root.
+ *
+ * Lookups work on an immutable per-process snapshot that a scan replaces,
+ * so scans and lookups may run concurrently from several threads. With a
+ * pool, batches for many processes are resolved in parallel. */
+class ProcessSymbolizer {
+    public:
+        explicit ProcessSymbolizer(ParserCache &cache, ThreadPool *pool = nullptr);
+
+        /* (re)read the mappings of pid; false when the process is gone */
+        bool scan(pid_t pid);
+        /* scan several processes across the pool; returns how many exist */
+        size_t scan(std::span<const pid_t> pids);
+        /* drop a process; objects no one else maps are released */
+        void forget(pid_t pid);
+
+        /* object and file virtual address of addr; object is null when
+         * addr is not in a mapped ELF file of a scanned process */
+        std::pair<std::shared_ptr<const mapped_object_t>, uint64_t> translate(pid_t pid, uint64_t addr) const;
+
+        /* addresses of one process, grouped by object and resolved with one
+         * batched SymbolResolver pass per object */
+        symbolized_t resolve(pid_t pid, std::span<const uint64_t> pcs) const;
+        /* one result per batch, in order */
+        std::vector<symbolized_t> resolve(std::span<const pc_batch_t> batches) const;
+
+        /* scans that found the maps unchanged, and mappings kept or added
+         * by the others */
+        size_t unchanged() const { return m_unchanged; }
+        size_t reused() const { return m_reused; }
+        size_t added() const { return m_added; }
+
+    private:
+        typedef struct {
+            process_mapping_t mapping;
+            std::shared_ptr<const mapped_object_t> object;
+            uint64_t bias = 0;      // runtime address - file virtual address
+            bool usable = false;    // an ELF file with a PT_LOAD covering the mapping
+        } region_t;
+
+        typedef struct {
+            std::string maps;               // the text the regions were read from
+            std::vector<region_t> regions;  // sorted by start
+        } process_t;
+
+        std::shared_ptr<const process_t> snapshot(pid_t pid) const;
+        void locate(pid_t pid, region_t &region);
+        static const region_t *find(const process_t &process, uint64_t addr);
+
+        ParserCache &m_cache;
+        ThreadPool *m_pool;
+
+        mutable std::mutex m_lock;
+        std::unordered_map<pid_t, std::shared_ptr<const process_t>> m_processes;
+        std::atomic<size_t> m_unchanged{0}, m_reused{0}, m_added{0};
+};
+
+}
+#endif
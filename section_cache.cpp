@@ -0,0 +1,180 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <zlib.h>
+#include "section_cache.hpp"
+#if __has_include(<zstd.h>)
+#include <zstd.h>
+#define ELF_PARSER_HAVE_ZSTD 1
+#endif
+using namespace elf_parser;
+
+SectionCache::SectionCache(const Elf_parser &elf, size_t max_bytes, parallel_for_t parallel_for)
+    : m_elf{elf}, m_max_bytes{max_bytes}, m_parallel_for{std::move(parallel_for)} {}
+
+std::shared_ptr<const std::vector<uint8_t>> SectionCache::decompress(
+        const section_ref_t &sec, const Elf64_Chdr &chdr) const {
+    std::shared_ptr<const void> keep;
+    std::string_view raw = m_elf.section_data(sec, keep);
+    size_t header = (m_elf.get_elf_class() == ELFCLASS32) ? sizeof(Elf32_Chdr) : sizeof(Elf64_Chdr);
+    auto *src = (const uint8_t*)raw.data() + header;
+    size_t src_size = raw.size() - header;
+    std::string name(sec.name);
+
+    if (chdr.ch_type == ELFCOMPRESS_ZLIB) {
+        // deflate expands at most ~1032:1; anything larger is corrupt
+        if (chdr.ch_size > 1032 * (uint64_t)src_size + 65536)
+            throw Elf_error("Err: bad uncompressed size in " + name);
+        auto out = std::make_shared<std::vector<uint8_t>>(chdr.ch_size);
+        uLongf out_size = chdr.ch_size;
+        uLong in_size = src_size;
+        int ret = uncompress2(out->data(), &out_size, src, &in_size);
+        if ((ret != Z_OK) || (out_size != chdr.ch_size))
+            throw Elf_error("Err: cannot inflate " + name);
+        return out;
+    }
+#ifdef ELF_PARSER_HAVE_ZSTD
+    if (chdr.ch_type == ELFCOMPRESS_ZSTD) {
+        // split into frames; each must record its content size
+        std::vector<std::pair<size_t, size_t>> frames;      // (input offset, size)
+        std::vector<size_t> out_offsets;
+        uint64_t total = 0;
+        for (size_t pos = 0; pos < src_size; ) {
+            size_t frame = ZSTD_findFrameCompressedSize(src + pos, src_size - pos);
+            unsigned long long content = ZSTD_getFrameContentSize(src + pos, src_size - pos);
+            if (ZSTD_isError(frame) || (content == ZSTD_CONTENTSIZE_UNKNOWN) ||
+                    (content == ZSTD_CONTENTSIZE_ERROR) || (content > chdr.ch_size - total))
+                throw Elf_error("Err: cannot decompress " + name);
+            frames.push_back({pos, frame});
+            out_offsets.push_back(total);
+            total += content;
+            pos += frame;
+        }
+        if (total != chdr.ch_size)
+            throw Elf_error("Err: bad uncompressed size in " + name);
+
+        auto out = std::make_shared<std::vector<uint8_t>>(chdr.ch_size);
+        std::atomic<bool> failed{false};
+        auto one = [&](size_t i) {
+            size_t end = (i + 1 < frames.size()) ? out_offsets[i + 1] : total;
+            size_t n = ZSTD_decompress(out->data() + out_offsets[i], end - out_offsets[i],
+                                       src + frames[i].first, frames[i].second);
+            if (ZSTD_isError(n) || (n != end - out_offsets[i]))
+                failed = true;
+        };
+        if (m_parallel_for && (frames.size() > 1))
+            m_parallel_for(frames.size(), one);
+        else
+            for (size_t i = 0; i < frames.size(); ++i)
+                one(i);
+        if (failed)
+            throw Elf_error("Err: cannot decompress " + name);
+        return out;
+    }
+#endif
+    throw Elf_error("Err: unsupported compression type " + std::to_string(chdr.ch_type) + " in " + name,
+                    Elf_errc::unsupported);
+}
+
+section_contents_t SectionCache::get(const section_ref_t &sec) {
+    auto chdr = m_elf.get_compression_header(sec);
+    if (!chdr) {
+        section_contents_t contents;
+        std::string_view raw = m_elf.section_data(sec, contents.keep);
+        contents.data = {(const uint8_t*)raw.data(), raw.size()};
+        return contents;
+    }
+
+    std::shared_ptr<slot_t> slot;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        auto &entry = m_slots[sec.index];
+        if (!entry) {
+            entry = std::make_shared<slot_t>();
+            ++m_stats.misses;
+        } else {
+            ++m_stats.hits;
+        }
+        slot = entry;
+        if (slot->cached) {
+            m_lru.splice(m_lru.begin(), m_lru, slot->lru);
+            return {{slot->data->data(), slot->data->size()}, slot->data, true};
+        }
+    }
+
+    // outside the lock: other sections stay available meanwhile
+    std::call_once(slot->once, [&] { slot->data = decompress(sec, *chdr); });
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    auto it = m_slots.find(sec.index);
+    if ((it != m_slots.end()) && (it->second == slot) && !slot->cached) {
+        slot->cached = true;
+        slot->lru = m_lru.insert(m_lru.begin(), sec.index);
+        m_stats.bytes_cached += slot->data->size();
+        m_stats.bytes_decompressed += slot->data->size();
+        // the newest entry stays even when it alone exceeds the bound
+        while ((m_stats.bytes_cached > m_max_bytes) && (m_lru.size() > 1)) {
+            auto victim = m_slots.find(m_lru.back());
+            m_stats.bytes_cached -= victim->second->data->size();
+            ++m_stats.evictions;
+            m_slots.erase(victim);
+            m_lru.pop_back();
+        }
+    }
+    return {{slot->data->data(), slot->data->size()}, slot->data, true};
+}
+
+std::optional<section_contents_t> SectionCache::get(std::string_view name) {
+    auto sec = m_elf.find_section(name);
+    if (!sec)
+        return std::nullopt;
+    return get(*sec);
+}
+
+std::vector<section_ref_t> SectionCache::prefetch(const std::vector<section_ref_t> &secs) {
+    // errors stay inside each call: one must not throw out of a pool worker
+    std::vector<char> failed(secs.size(), 0);
+    auto one = [&](size_t i) {
+        try {
+            get(secs[i]);
+        } catch (const std::exception &) {
+            failed[i] = 1;
+        }
+    };
+    if (m_parallel_for)
+        m_parallel_for(secs.size(), one);
+    else
+        for (size_t i = 0; i < secs.size(); ++i)
+            one(i);
+
+    std::vector<section_ref_t> out;
+    for (size_t i = 0; i < secs.size(); ++i) {
+        if (failed[i])
+            out.push_back(secs[i]);
+    }
+    return out;
+}
+
+section_cache_stats_t SectionCache::stats() const {
+    std::lock_guard<std::mutex> guard(m_lock);
+    return m_stats;
+}
@@ -0,0 +1,96 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_SECTION_CACHE
+#define H_SECTION_CACHE
+
+#include <list>
+#include <span>
+#include "elf_parser.hpp"
+
+#ifndef ELFCOMPRESS_ZSTD
+#define ELFCOMPRESS_ZSTD 2
+#endif
+
+namespace elf_parser {
+
+/* section bytes handed out by SectionCache; data stays valid while keep
+ * (or, for uncompressed sections, the parser) is alive */
+typedef struct {
+    std::span<const uint8_t> data;
+    std::shared_ptr<const void> keep;
+    bool decompressed = false;
+} section_contents_t;
+
+typedef struct {
+    uint64_t hits = 0, misses = 0, evictions = 0;
+    uint64_t bytes_cached = 0;          // decompressed bytes held right now
+    uint64_t bytes_decompressed = 0;    // in total, including evicted ones
+} section_cache_stats_t;
+
+/* Section contents, with SHF_COMPRESSED sections decompressed on first
+ * access: zlib, and zstd when built where <zstd.h> exists (link -lz, and
+ * -lzstd then). Decompressed buffers sit in an LRU bounded by max_bytes and
+ * are reference counted, so eviction only drops the cache's reference and
+ * handed-out contents stay valid. Uncompressed sections point into the
+ * parser, which must outlive the cache. Concurrent requests for a section
+ * decompress it once. A zstd section made of several frames is decompressed
+ * frame by frame through parallel_for when one is given; a zlib stream is
+ * inherently serial. Throws Elf_error for corrupt or unsupported data. */
+class SectionCache {
+    public:
+        explicit SectionCache(const Elf_parser &elf, size_t max_bytes = 256 << 20,
+                              parallel_for_t parallel_for = nullptr);
+
+        section_contents_t get(const section_ref_t &sec);
+        std::optional<section_contents_t> get(std::string_view name);
+
+        /* decompress several sections at once, spread over parallel_for.
+         * Never throws for a bad section: it returns the ones that failed,
+         * in input order, and get() on one of them throws its error */
+        std::vector<section_ref_t> prefetch(const std::vector<section_ref_t> &secs);
+
+        section_cache_stats_t stats() const;
+
+    private:
+        typedef struct {
+            std::once_flag once;
+            std::shared_ptr<const std::vector<uint8_t>> data;
+            std::list<int>::iterator lru;
+            bool cached = false;
+        } slot_t;
+
+        std::shared_ptr<const std::vector<uint8_t>> decompress(
+            const section_ref_t &sec, const Elf64_Chdr &chdr) const;
+
+        const Elf_parser &m_elf;
+        size_t m_max_bytes;
+        parallel_for_t m_parallel_for;
+
+        mutable std::mutex m_lock;
+        std::unordered_map<int, std::shared_ptr<slot_t>> m_slots;    // by section index
+        std::list<int> m_lru;                                       // most recent first
+        section_cache_stats_t m_stats;
+};
+
+}
+#endif
@@ -0,0 +1,323 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include "size_attribution.hpp"
+using namespace elf_parser;
+
+static const uint64_t prime1 = 0x9e3779b185ebca87ull, prime2 = 0xc2b2ae3d27d4eb4full;
+static const uint64_t prime3 = 0x165667b19e3779f9ull, prime4 = 0x85ebca77c2b2ae63ull;
+static const uint64_t prime5 = 0x27d4eb2f165667c5ull;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    return rotl(acc + input * prime2, 31) * prime1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t lane) {
+    return (acc ^ xxh_round(0, lane)) * prime1 + prime4;
+}
+
+uint64_t elf_parser::xxh64(const void *data, size_t size, uint64_t seed) {
+    auto p = (const uint8_t*)data, end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        // the lanes do not depend on each other, so their multiplies overlap
+        uint64_t v1 = seed + prime1 + prime2, v2 = seed + prime2, v3 = seed, v4 = seed - prime1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = xxh_round(v1, read64(p));
+            v2 = xxh_round(v2, read64(p + 8));
+            v3 = xxh_round(v3, read64(p + 16));
+            v4 = xxh_round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = xxh_merge(h, v1);
+        h = xxh_merge(h, v2);
+        h = xxh_merge(h, v3);
+        h = xxh_merge(h, v4);
+    } else {
+        h = seed + prime5;
+    }
+    h += size;
+
+    for (; p + 8 <= end; p += 8)
+        h = rotl(h ^ xxh_round(0, read64(p)), 27) * prime1 + prime4;
+    if (p + 4 <= end) {
+        h = rotl(h ^ (read32(p) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+        h = rotl(h ^ (*p * prime5), 11) * prime1;
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+/* split items into consecutive ranges of about chunk_bytes each */
+template <typename Bytes>
+static std::vector<size_t> chunk_bounds(size_t n, size_t chunk_bytes, Bytes bytes) {
+    std::vector<size_t> bounds{0};
+    size_t filled = 0;
+    for (size_t i = 0; i < n; ++i) {
+        filled += bytes(i);
+        if (filled >= chunk_bytes) {
+            bounds.push_back(i + 1);
+            filled = 0;
+        }
+    }
+    if (bounds.back() != n)
+        bounds.push_back(n);
+    return bounds;
+}
+
+static void run_all(size_t n, const std::function<void(size_t)> &fn, const attribution_options_t &options) {
+    if (options.parallel_for && n > 1)
+        options.parallel_for(n, fn);
+    else
+        for (size_t i = 0; i < n; ++i)
+            fn(i);
+}
+
+/* std::sort in chunks across parallel_for, then neighbouring runs merged
+ * pairwise, each round in parallel */
+template <typename T, typename Less>
+static void parallel_sort(std::vector<T> &items, Less less, const attribution_options_t &options) {
+    static const size_t chunk = 1 << 16;
+    size_t n = items.size();
+    if (!options.parallel_for || n <= chunk) {
+        std::sort(items.begin(), items.end(), less);
+        return;
+    }
+    auto first = items.begin();
+    run_all((n + chunk - 1) / chunk, [&](size_t c) {
+        std::sort(first + c * chunk, first + std::min(n, (c + 1) * chunk), less);
+    }, options);
+    for (size_t width = chunk; width < n; width *= 2) {
+        run_all((n + 2 * width - 1) / (2 * width), [&](size_t p) {
+            size_t lo = p * 2 * width;
+            std::inplace_merge(first + lo, first + std::min(n, lo + width),
+                               first + std::min(n, lo + 2 * width), less);
+        }, options);
+    }
+}
+
+SizeAttribution::SizeAttribution(const Elf_parser &elf, const attribution_options_t &options) {
+    auto secs = elf.sections();
+    m_sections.resize(secs.size());
+    for (auto sec : secs)
+        m_sections[sec.index] = {sec.index, sec.name, sec.header->sh_size};
+
+    auto &tables = elf.find_sections(SHT_SYMTAB).empty() ? elf.find_sections(SHT_DYNSYM)
+                                                         : elf.find_sections(SHT_SYMTAB);
+    if (tables.empty())
+        return;
+    m_table = elf.symbols(tables.front());
+
+    // contents of the sections symbols point into, read on first use
+    std::vector<std::string_view> data(secs.size());
+    std::vector<bool> loaded(secs.size());
+    std::vector<std::shared_ptr<const void>> keep(secs.size());
+    std::vector<const uint8_t*> bytes;      // per symbol, nullptr without a body
+    m_symbols.reserve(m_table.size());
+    bytes.reserve(m_table.size());
+
+    bool thumb = elf.get_machine() == EM_ARM;
+    for (size_t row = 1; row < m_table.size(); ++row) {
+        auto sym = m_table[row];
+        uint8_t type = ELF64_ST_TYPE(sym.sym->st_info);
+        uint16_t shndx = sym.sym->st_shndx;
+        bool wanted = type == STT_FUNC || type == STT_GNU_IFUNC || (options.objects && type == STT_OBJECT);
+        if (!wanted || !sym.sym->st_size || shndx == SHN_UNDEF || shndx >= SHN_LORESERVE ||
+            shndx >= secs.size())
+            continue;
+
+        symbol_size_t symbol;
+        symbol.name = sym.name;
+        symbol.row = row;
+        symbol.section = shndx;
+        symbol.type = type;
+        // the low bit of a Thumb function address selects the instruction set
+        symbol.addr = (thumb && type != STT_OBJECT) ? sym.sym->st_value & ~1ull : sym.sym->st_value;
+        symbol.size = sym.sym->st_size;
+        symbol.body = m_symbols.size();
+
+        // relocatable files leave sh_addr 0, so this is st_value for them
+        auto shdr = secs[shndx].header;
+        if (!loaded[shndx]) {
+            if (!(shdr->sh_flags & SHF_COMPRESSED))
+                data[shndx] = elf.section_data(secs[shndx], keep[shndx]);
+            loaded[shndx] = true;
+        }
+        uint64_t start = symbol.addr - shdr->sh_addr;
+        const uint8_t *body = nullptr;
+        if ((symbol.addr >= shdr->sh_addr) && (start < data[shndx].size()) &&
+            (symbol.size <= data[shndx].size() - start)) {
+            symbol.offset = shdr->sh_offset + start;
+            body = (const uint8_t*)data[shndx].data() + start;
+        }
+        ++m_sections[shndx].symbols;
+        m_symbols.push_back(symbol);
+        bytes.push_back(body);
+    }
+
+    // aliases share a body; the union of all bodies is what a section
+    // has attributed. Sorting compact copies keeps the compares in cache
+    typedef struct {
+        uint64_t addr, size;
+        uint32_t section, index;
+    } place_t;
+    std::vector<place_t> places(m_symbols.size());
+    for (uint32_t i = 0; i < places.size(); ++i)
+        places[i] = {m_symbols[i].addr, m_symbols[i].size, m_symbols[i].section, i};
+    parallel_sort(places, [](const place_t &a, const place_t &b) {
+        if (a.section != b.section)
+            return a.section < b.section;
+        return a.addr != b.addr ? a.addr < b.addr : a.size != b.size ? a.size < b.size : a.index < b.index;
+    }, options);
+
+    std::vector<uint32_t> bodies;           // by address
+    uint64_t covered_end = 0;
+    for (size_t k = 0; k < places.size(); ++k) {
+        auto &place = places[k];
+        bool same_section = k && (places[k - 1].section == place.section);
+        bool alias = same_section && (places[k - 1].addr == place.addr) && (places[k - 1].size == place.size);
+        auto &symbol = m_symbols[place.index];
+        symbol.body = alias ? m_symbols[places[k - 1].index].body : place.index;
+        if (!alias && bytes[place.index])
+            bodies.push_back(place.index);
+
+        auto shdr = secs[place.section].header;
+        if (!same_section)
+            covered_end = 0;
+        if (place.addr < shdr->sh_addr)
+            continue;
+        uint64_t start = std::min<uint64_t>(place.addr - shdr->sh_addr, shdr->sh_size);
+        uint64_t end = start + std::min<uint64_t>(place.size, shdr->sh_size - start);
+        start = std::max(start, covered_end);
+        if (end > start) {
+            m_sections[place.section].attributed += end - start;
+            covered_end = end;
+        }
+    }
+
+    auto bounds = chunk_bounds(bodies.size(), options.chunk_bytes,
+                               [&](size_t i) { return m_symbols[bodies[i]].size; });
+    run_all(bounds.size() - 1, [&](size_t c) {
+        for (size_t i = bounds[c]; i < bounds[c + 1]; ++i) {
+            auto &symbol = m_symbols[bodies[i]];
+            symbol.hash = xxh64(bytes[bodies[i]], symbol.size);
+        }
+    }, options);
+    for (auto &symbol : m_symbols)
+        symbol.hash = m_symbols[symbol.body].hash;
+    for (uint32_t i : bodies)
+        m_hashed_bytes += m_symbols[i].size;
+
+    // runs of equal hash, size and type, by address within a run
+    typedef struct {
+        uint64_t hash, size;
+        uint32_t pos;       // into bodies
+        uint8_t type;
+    } content_t;
+    std::vector<content_t> contents(bodies.size());
+    for (uint32_t i = 0; i < contents.size(); ++i) {
+        auto &symbol = m_symbols[bodies[i]];
+        contents[i] = {symbol.hash, symbol.size, i, symbol.type};
+    }
+    parallel_sort(contents, [](const content_t &a, const content_t &b) {
+        if (a.hash != b.hash)
+            return a.hash < b.hash;
+        if (a.size != b.size)
+            return a.size < b.size;
+        return a.type != b.type ? a.type < b.type : a.pos < b.pos;
+    }, options);
+    std::vector<std::pair<size_t, size_t>> runs;
+    for (size_t i = 0, j; i < contents.size(); i = j) {
+        for (j = i + 1; j < contents.size() && contents[j].hash == contents[i].hash &&
+                        contents[j].size == contents[i].size && contents[j].type == contents[i].type; ++j)
+            ;
+        if (j - i > 1)
+            runs.push_back({i, j});
+    }
+
+    // confirm each run byte for byte; a hash collision splits it
+    std::vector<std::vector<identical_group_t>> found(runs.size());
+    auto run_bounds = chunk_bounds(runs.size(), options.chunk_bytes, [&](size_t r) {
+        return (runs[r].second - runs[r].first) * contents[runs[r].first].size;
+    });
+    run_all(run_bounds.size() - 1, [&](size_t c) {
+        for (size_t r = run_bounds[c]; r < run_bounds[c + 1]; ++r) {
+            std::vector<uint32_t> left;
+            for (size_t i = runs[r].first; i < runs[r].second; ++i)
+                left.push_back(bodies[contents[i].pos]);
+            while (left.size() > 1) {
+                auto &leader = m_symbols[left[0]];
+                identical_group_t group;
+                group.hash = leader.hash;
+                group.size = leader.size;
+                group.type = leader.type;
+                std::vector<uint32_t> rest;
+                for (uint32_t i : left) {
+                    if (memcmp(bytes[left[0]], bytes[i], leader.size) == 0)
+                        group.symbols.push_back(i);
+                    else
+                        rest.push_back(i);
+                }
+                if (group.symbols.size() > 1) {
+                    group.saved = group.size * (group.symbols.size() - 1);
+                    found[r].push_back(std::move(group));
+                }
+                left.swap(rest);
+            }
+        }
+    }, options);
+
+    for (auto &groups : found) {
+        for (auto &group : groups) {
+            for (size_t i = 1; i < group.symbols.size(); ++i)
+                m_sections[m_symbols[group.symbols[i]].section].identical += group.size;
+            m_identical.push_back(std::move(group));
+        }
+    }
+    std::stable_sort(m_identical.begin(), m_identical.end(),
+                     [](const identical_group_t &a, const identical_group_t &b) { return a.saved > b.saved; });
+}
@@ -0,0 +1,106 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_SIZE_ATTRIBUTION
+#define H_SIZE_ATTRIBUTION
+
+#include "elf_parser.hpp"
+
+namespace elf_parser {
+
+/* XXH64 of size bytes. Four independent 64-bit lanes take 32 bytes per
+ * step, so a core hashes several GB/s */
+uint64_t xxh64(const void *data, size_t size, uint64_t seed = 0);
+
+/* one FUNC or OBJECT symbol and the bytes it owns */
+typedef struct {
+    std::string_view name;
+    uint32_t row = 0;           // index in the symbol table
+    uint16_t section = 0;
+    uint8_t type = 0;           // STT_FUNC, STT_GNU_IFUNC or STT_OBJECT
+    uint64_t addr = 0, size = 0;
+    /* file offset of the body; 0 when it has no bytes in the file
+     * (SHT_NOBITS, compressed, or past the end of its section) */
+    uint64_t offset = 0;
+    uint64_t hash = 0;          // xxh64() of the body, 0 without bytes
+    /* the first symbol at the same section, address and size; aliases
+     * share a body and only that one is grouped below */
+    uint32_t body = 0;
+} symbol_size_t;
+
+/* per-section rollup */
+typedef struct {
+    int index = 0;
+    std::string_view name;
+    uint64_t size = 0;              // sh_size
+    uint64_t symbols = 0;           // FUNC and OBJECT symbols in it
+    uint64_t attributed = 0;        // bytes covered by at least one of them
+    uint64_t identical = 0;         // bytes repeating an earlier identical body
+} section_size_t;
+
+/* distinct bodies of one type that are byte for byte the same */
+typedef struct {
+    uint64_t hash = 0, size = 0;
+    uint8_t type = 0;
+    std::vector<uint32_t> symbols;  // into symbols(), one per body, by address
+    uint64_t saved = 0;             // size * (symbols.size() - 1)
+} identical_group_t;
+
+typedef struct {
+    /* bodies are hashed in chunks of about chunk_bytes through
+     * parallel_for, when set */
+    parallel_for_t parallel_for;
+    size_t chunk_bytes = 4 << 20;
+    bool objects = true;            // OBJECT symbols too, not just functions
+} attribution_options_t;
+
+/* Which symbols own which bytes. Every sized FUNC and OBJECT symbol of
+ * .symtab (.dynsym when stripped) is placed in its section: at st_value -
+ * sh_addr in linked files, at st_value in relocatable ones. Bodies are
+ * hashed, then grouped by type, size and hash and confirmed with a byte
+ * compare. In a relocatable file unrelocated bodies can compare equal
+ * while their relocations differ, so treat those groups as candidates. */
+class SizeAttribution {
+    public:
+        explicit SizeAttribution(const Elf_parser &elf,
+                                 const attribution_options_t &options = attribution_options_t());
+
+        /* in table order */
+        const std::vector<symbol_size_t> &symbols() const { return m_symbols; }
+        /* every section, in index order */
+        const std::vector<section_size_t> &sections() const { return m_sections; }
+        /* groups of two or more bodies, largest saving first */
+        const std::vector<identical_group_t> &identical() const { return m_identical; }
+
+        /* bytes hashed */
+        uint64_t hashed_bytes() const { return m_hashed_bytes; }
+
+    private:
+        SymbolView m_table;     // holds the names in streaming mode
+        std::vector<symbol_size_t> m_symbols;
+        std::vector<section_size_t> m_sections;
+        std::vector<identical_group_t> m_identical;
+        uint64_t m_hashed_bytes = 0;
+};
+
+}
+#endif
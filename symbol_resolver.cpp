@@ -0,0 +1,203 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include "symbol_resolver.hpp"
+using namespace elf_parser;
+
+// ranks aliases at the same address: sized beats zero-sized, then
+// GLOBAL > WEAK > LOCAL, then FUNC over OBJECT
+static int alias_rank(const Elf64_Sym *sym) {
+    int rank = sym->st_size ? 8 : 0;
+    switch (ELF64_ST_BIND(sym->st_info)) {
+        case STB_GLOBAL: rank += 4; break;
+        case STB_WEAK:   rank += 2; break;
+    }
+    if (ELF64_ST_TYPE(sym->st_info) == STT_FUNC)
+        rank += 1;
+    return rank;
+}
+
+SymbolResolver::SymbolResolver(const Elf_parser &elf) {
+    std::vector<symbol_ref_t> refs;
+    for (auto sec : elf.sections()) {
+        if ((sec.header->sh_type != SHT_SYMTAB) && (sec.header->sh_type != SHT_DYNSYM))
+            continue;
+
+        // the views pin the table and name buffers in streaming mode
+        m_tables.push_back(elf.symbols(sec));
+        for (auto sym : m_tables.back()) {
+            int type = ELF64_ST_TYPE(sym.sym->st_info);
+            if ((type != STT_FUNC) && (type != STT_OBJECT))
+                continue;
+            // a defined symbol may sit at address 0; ABS ones are not addresses
+            if ((sym.sym->st_shndx == SHN_UNDEF) || (sym.sym->st_shndx == SHN_ABS))
+                continue;
+            refs.push_back(sym);
+        }
+    }
+
+    std::sort(refs.begin(), refs.end(), [](const symbol_ref_t &a, const symbol_ref_t &b) {
+        if (a.sym->st_value != b.sym->st_value)
+            return a.sym->st_value < b.sym->st_value;
+        return alias_rank(a.sym) > alias_rank(b.sym);
+    });
+
+    // keep the best-ranked alias per address, covering the largest extent
+    m_syms.reserve(refs.size());
+    for (auto &ref : refs) {
+        if (!m_syms.empty() && (m_syms.back().addr == ref.sym->st_value)) {
+            m_syms.back().end = std::max(m_syms.back().end, ref.sym->st_value + ref.sym->st_size);
+            continue;
+        }
+        m_syms.push_back({ref.sym->st_value, ref.sym->st_value + ref.sym->st_size, ref.name, npos});
+    }
+
+    // zero-sized symbols extend to the next symbol; the last one is unbounded
+    for (size_t i = 0; i < m_syms.size(); ++i) {
+        if (m_syms[i].end != m_syms[i].addr)
+            continue;
+        m_syms[i].end = (i + 1 < m_syms.size()) ? m_syms[i + 1].addr : UINT64_MAX;
+    }
+
+    // link each entry to the nearest earlier entry that still covers it
+    std::vector<uint32_t> open;
+    for (size_t i = 0; i < m_syms.size(); ++i) {
+        while (!open.empty() && (m_syms[open.back()].end <= m_syms[i].addr))
+            open.pop_back();
+        m_syms[i].parent = open.empty() ? npos : open.back();
+        open.push_back(i);
+    }
+
+    m_eytz.resize(m_syms.size() + 1);
+    m_eytz_rank.resize(m_syms.size() + 1);
+    size_t i = 0;
+    build_eytzinger(1, i);
+}
+
+void SymbolResolver::build_eytzinger(size_t k, size_t &i) {
+    if (k > m_syms.size())
+        return;
+    build_eytzinger(2 * k, i);
+    m_eytz[k] = m_syms[i].addr;
+    m_eytz_rank[k] = i++;
+    build_eytzinger(2 * k + 1, i);
+}
+
+// index of the last entry with addr <= x, or m_syms.size() if none
+size_t SymbolResolver::predecessor(uint64_t addr) const {
+    const size_t n = m_syms.size();
+    const uint64_t *eytz = m_eytz.data();
+
+    size_t k = 1;
+    while (k <= n) {
+        __builtin_prefetch(eytz + k * 8);
+        k = 2 * k + (eytz[k] <= addr);
+    }
+    // strip the trailing right turns to land on the first entry > addr
+    k >>= __builtin_ffsll(~k);
+
+    size_t upper = k ? m_eytz_rank[k] : n;
+    return upper ? upper - 1 : n;
+}
+
+resolution_t SymbolResolver::match(size_t i, uint64_t addr) const {
+    resolution_t res;
+    while ((i != npos) && (i < m_syms.size())) {
+        auto &sym = m_syms[i];
+        if (addr < sym.end) {
+            res.found = true;
+            res.symbol_name = sym.name;
+            res.symbol_addr = sym.addr;
+            res.symbol_size = (sym.end == UINT64_MAX) ? 0 : sym.end - sym.addr;
+            res.offset = addr - sym.addr;
+            break;
+        }
+        i = sym.parent;
+    }
+    return res;
+}
+
+resolution_t SymbolResolver::resolve(uint64_t addr) const {
+    return match(predecessor(addr), addr);
+}
+
+// LSD radix sort on (addr - min); PCs of one binary span a narrow range,
+// so only a few 11-bit passes are needed
+static void radix_sort(std::vector<std::pair<uint64_t, uint32_t>> &pcs) {
+    if (std::is_sorted(pcs.begin(), pcs.end()))
+        return;
+    if (pcs.size() < 256) {
+        std::sort(pcs.begin(), pcs.end());
+        return;
+    }
+
+    uint64_t lo = UINT64_MAX, hi = 0;
+    for (auto &pc : pcs) {
+        lo = std::min(lo, pc.first);
+        hi = std::max(hi, pc.first);
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> tmp(pcs.size());
+    for (unsigned shift = 0; shift < 64 && ((hi - lo) >> shift); shift += 11) {
+        size_t count[2048] = {0};
+        for (auto &pc : pcs)
+            ++count[((pc.first - lo) >> shift) & 2047];
+
+        size_t sum = 0;
+        for (auto &c : count) {
+            size_t n = c;
+            c = sum;
+            sum += n;
+        }
+        for (auto &pc : pcs)
+            tmp[count[((pc.first - lo) >> shift) & 2047]++] = pc;
+        pcs.swap(tmp);
+    }
+}
+
+std::vector<resolution_t> SymbolResolver::resolve(std::span<const uint64_t> addrs) const {
+    std::vector<resolution_t> results(addrs.size());
+
+    std::vector<std::pair<uint64_t, uint32_t>> order(addrs.size());
+    for (size_t i = 0; i < addrs.size(); ++i)
+        order[i] = {addrs[i], (uint32_t)i};
+    radix_sort(order);
+
+    // merge the sorted input against the sorted symbols, galloping from the
+    // previous position: O(log gap) per address, so a batch much smaller
+    // than the table does not walk all of it
+    auto addr_less = [](uint64_t addr, const entry_t &sym) { return addr < sym.addr; };
+    size_t i = 0, n = m_syms.size();
+    for (auto &pc : order) {
+        size_t lo = i;
+        for (size_t step = 1; (i < n) && (m_syms[i].addr <= pc.first); step *= 2) {
+            lo = i + 1;
+            i += step;
+        }
+        // the first entry past pc lies in [lo, i]
+        auto hi = m_syms.begin() + std::min(i, n);
+        i = std::upper_bound(m_syms.begin() + lo, hi, pc.first, addr_less) - m_syms.begin();
+        results[pc.second] = match(i ? i - 1 : n, pc.first);
+    }
+    return results;
+}
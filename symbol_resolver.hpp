@@ -0,0 +1,83 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_SYMBOL_RESOLVER
+#define H_SYMBOL_RESOLVER
+
+#include <span>
+#include "elf_parser.hpp"
+
+namespace elf_parser {
+
+typedef struct {
+    bool found = false;
+    std::string_view symbol_name;   // points into the parser's string table
+    uint64_t symbol_addr = 0, symbol_size = 0;
+    uint64_t offset = 0;            // address - symbol_addr
+} resolution_t;
+
+/* Maps addresses to the FUNC/OBJECT symbol that encloses them.
+ *
+ * Symbols from .symtab and .dynsym are merged and deduplicated by address;
+ * undefined and SHN_ABS symbols are left out, defined ones at 0 are kept.
+ * A symbol with st_size == 0 extends to the next symbol; a sized symbol that
+ * does not contain the address falls back to the nearest enclosing one, so
+ * nested and overlapping aliases resolve to the innermost match. Start
+ * addresses are kept in Eytzinger (BFS) order for a branch-free search. */
+class SymbolResolver {
+    public:
+        explicit SymbolResolver(const Elf_parser &elf);
+
+        resolution_t resolve(uint64_t addr) const;
+
+        /* resolve many addresses at once; the input is sorted internally and
+         * merged against the symbol array with a galloping search, so small
+         * batches stay cheap on large tables. Results are in input order */
+        std::vector<resolution_t> resolve(std::span<const uint64_t> addrs) const;
+
+        size_t size() const { return m_syms.size(); }
+
+        typedef struct {
+            uint64_t addr, end;     // [addr, end)
+            std::string_view name;
+            uint32_t parent;        // nearest earlier entry that still covers addr
+        } entry_t;
+
+        static constexpr uint32_t npos = ~0u;
+
+        /* the merged ranges, sorted by addr; end is UINT64_MAX for an
+         * unbounded trailing symbol */
+        const std::vector<entry_t> &entries() const { return m_syms; }
+
+    private:
+        void build_eytzinger(size_t i, size_t &k);
+        size_t predecessor(uint64_t addr) const;
+        resolution_t match(size_t i, uint64_t addr) const;
+
+        std::vector<SymbolView> m_tables;   // keeps symbol names alive
+        std::vector<entry_t> m_syms;        // sorted by addr
+        std::vector<uint64_t> m_eytz;       // 1-based BFS layout of addrs
+        std::vector<uint32_t> m_eytz_rank;  // eytzinger slot -> index in m_syms
+};
+
+}
+#endif
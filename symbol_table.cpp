@@ -0,0 +1,111 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "symbol_table.hpp"
+using namespace elf_parser;
+
+SymbolTable::SymbolTable(const Elf_parser &elf): m_elf{elf} {
+    size_t total = 0;
+    for (auto sec : elf.sections()) {
+        if ((sec.header->sh_type != SHT_SYMTAB) && (sec.header->sh_type != SHT_DYNSYM))
+            continue;
+        m_tables.push_back(elf.symbols(sec));
+        total += m_tables.back().size();
+    }
+    // the m_table column is 16 bits wide
+    if (m_tables.size() > 65536)
+        throw Elf_error("Too many symbol tables: " + std::to_string(m_tables.size()));
+
+    m_value.resize(total);
+    m_size.resize(total);
+    m_name.resize(total);
+    m_num.resize(total);
+    m_shndx.resize(total);
+    m_table.resize(total);
+    m_type.resize(total);
+    m_bind.resize(total);
+    m_vis.resize(total);
+
+    size_t row = 0;
+    for (size_t t = 0; t < m_tables.size(); ++t) {
+        for (auto sym : m_tables[t]) {
+            m_value[row] = sym.sym->st_value;
+            m_size[row]  = sym.sym->st_size;
+            m_name[row]  = sym.sym->st_name;
+            m_num[row]   = sym.num;
+            m_shndx[row] = sym.sym->st_shndx;
+            m_table[row] = t;
+            m_type[row]  = (symbol_type_t)ELF64_ST_TYPE(sym.sym->st_info);
+            m_bind[row]  = (symbol_bind_t)ELF64_ST_BIND(sym.sym->st_info);
+            m_vis[row]   = (symbol_visibility_t)ELF64_ST_VISIBILITY(sym.sym->st_other);
+            ++row;
+        }
+    }
+}
+
+std::string_view SymbolTable::name(size_t row) const {
+    const char *strtab = m_tables[m_table[row]].strtab();
+    return strtab ? std::string_view(strtab + m_name[row]) : std::string_view();
+}
+
+std::string_view SymbolTable::table_name(size_t row) const {
+    return m_tables[m_table[row]].name();
+}
+
+std::vector<uint32_t> SymbolTable::select(symbol_type_t type, symbol_bind_t bind) const {
+    const size_t n = size();
+    auto types = (const uint8_t*)m_type.data();
+    auto binds = (const uint8_t*)m_bind.data();
+    uint8_t want_type = (uint8_t)type, want_bind = (uint8_t)bind;
+
+    // first pass is a plain byte compare the compiler vectorizes
+    std::vector<uint8_t> mask(n);
+    for (size_t i = 0; i < n; ++i)
+        mask[i] = (types[i] == want_type) & (binds[i] == want_bind);
+
+    size_t hits = 0;
+    for (size_t i = 0; i < n; ++i)
+        hits += mask[i];
+
+    // branch-free compaction; the spare slot absorbs the trailing store
+    std::vector<uint32_t> rows(hits + 1);
+    for (size_t i = 0, j = 0; i < n; ++i) {
+        rows[j] = i;
+        j += mask[i];
+    }
+    rows.resize(hits);
+    return rows;
+}
+
+symbol_t SymbolTable::to_symbol(size_t row) const {
+    symbol_t symbol;
+    m_elf.decode_symbol(m_tables[m_table[row]][m_num[row]], symbol);
+    return symbol;
+}
+
+size_t SymbolTable::memory_usage() const {
+    return m_value.capacity() * sizeof(uint64_t) + m_size.capacity() * sizeof(uint64_t) +
+           m_name.capacity() * sizeof(uint32_t) + m_num.capacity() * sizeof(uint32_t) +
+           m_shndx.capacity() * sizeof(uint16_t) + m_table.capacity() * sizeof(uint16_t) +
+           m_type.capacity() + m_bind.capacity() + m_vis.capacity() +
+           m_tables.capacity() * sizeof(SymbolView);
+}
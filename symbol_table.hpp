@@ -0,0 +1,93 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_SYMBOL_TABLE
+#define H_SYMBOL_TABLE
+
+#include "elf_parser.hpp"
+
+namespace elf_parser {
+
+/* the ELF values themselves, so a column converts with a cast */
+enum class symbol_type_t : uint8_t {
+    notype = STT_NOTYPE, object = STT_OBJECT, func = STT_FUNC, section = STT_SECTION,
+    file = STT_FILE, common = STT_COMMON, tls = STT_TLS, gnu_ifunc = STT_GNU_IFUNC
+};
+
+enum class symbol_bind_t : uint8_t {
+    local = STB_LOCAL, global = STB_GLOBAL, weak = STB_WEAK, gnu_unique = STB_GNU_UNIQUE
+};
+
+enum class symbol_visibility_t : uint8_t {
+    default_ = STV_DEFAULT, internal = STV_INTERNAL, hidden = STV_HIDDEN, protected_ = STV_PROTECTED
+};
+
+/* Structure-of-arrays copy of every .symtab/.dynsym entry, in get_symbols()
+ * order. Fields are kept as typed numeric columns with 64-bit values and
+ * sizes; names stay offsets into the mapped string table and are only
+ * turned into strings on request. Throws Elf_error for a file with more
+ * than 65536 symbol tables. */
+class SymbolTable {
+    public:
+        explicit SymbolTable(const Elf_parser &elf);
+
+        size_t size() const { return m_value.size(); }
+
+        /* columns, indexed by row */
+        const std::vector<uint64_t> &values() const { return m_value; }
+        const std::vector<uint64_t> &sizes() const { return m_size; }
+        const std::vector<uint32_t> &name_offsets() const { return m_name; }
+        const std::vector<uint32_t> &nums() const { return m_num; }
+        const std::vector<uint16_t> &section_indices() const { return m_shndx; }
+        const std::vector<symbol_type_t> &types() const { return m_type; }
+        const std::vector<symbol_bind_t> &binds() const { return m_bind; }
+        const std::vector<symbol_visibility_t> &visibilities() const { return m_vis; }
+
+        std::string_view name(size_t row) const;
+        /* name of the symbol table section the row came from */
+        std::string_view table_name(size_t row) const;
+
+        /* rows matching type and bind, e.g. all GLOBAL FUNC entries; the
+         * scan is a branch-free pass over two byte columns */
+        std::vector<uint32_t> select(symbol_type_t type, symbol_bind_t bind) const;
+
+        /* the get_symbols() rendering of one row */
+        symbol_t to_symbol(size_t row) const;
+
+        /* heap bytes held by the columns */
+        size_t memory_usage() const;
+
+    private:
+        const Elf_parser &m_elf;
+        std::vector<SymbolView> m_tables;
+
+        std::vector<uint64_t> m_value, m_size;
+        std::vector<uint32_t> m_name, m_num;
+        std::vector<uint16_t> m_shndx;
+        std::vector<uint16_t> m_table;      // index into m_tables
+        std::vector<symbol_type_t> m_type;
+        std::vector<symbol_bind_t> m_bind;
+        std::vector<symbol_visibility_t> m_vis;
+};
+
+}
+#endif
@@ -0,0 +1,160 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include "thread_pool.hpp"
+using namespace elf_parser;
+
+// the pool and queue index of the calling thread, when it is a worker
+static thread_local const ThreadPool *t_pool = nullptr;
+static thread_local size_t t_self = 0;
+
+ThreadPool::ThreadPool(size_t nthreads) {
+    if (nthreads == 0)
+        nthreads = 1;
+
+    for (size_t i = 0; i < nthreads; ++i)
+        m_queues.emplace_back(new queue_t);
+    for (size_t i = 0; i < nthreads; ++i)
+        m_threads.emplace_back(&ThreadPool::worker, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stop = true;
+    }
+    m_work_cv.notify_all();
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t target = (t_pool == this) ? t_self : m_next++ % m_queues.size();
+    {
+        std::lock_guard<std::mutex> guard(m_queues[target]->lock);
+        m_queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        ++m_queued;
+        ++m_pending;
+    }
+    m_work_cv.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_done_cv.wait(guard, [this] { return m_pending == 0; });
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t)> &fn) {
+    typedef struct {
+        std::atomic<size_t> next{0}, done{0};
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;       // the first one thrown, under lock
+        std::mutex lock;
+        std::condition_variable done_cv;
+    } range_t;
+    auto range = std::make_shared<range_t>();
+
+    // helpers that start after the range is exhausted never touch fn; an
+    // exception must not leave a worker, so it is kept for the caller
+    auto run = [range, n, &fn] {
+        size_t i;
+        while ((i = range->next++) < n) {
+            if (!range->failed) {
+                try {
+                    fn(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard(range->lock);
+                    if (!range->error)
+                        range->error = std::current_exception();
+                    range->failed = true;
+                }
+            }
+            if (++range->done == n) {
+                std::lock_guard<std::mutex> guard(range->lock);
+                range->done_cv.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(n, size()) ? std::min(n, size()) - 1 : 0;
+    for (size_t i = 0; i < helpers; ++i)
+        submit(run);
+    run();
+
+    std::unique_lock<std::mutex> guard(range->lock);
+    range->done_cv.wait(guard, [&] { return range->done == n; });
+    if (range->error)
+        std::rethrow_exception(range->error);
+}
+
+bool ThreadPool::pop_task(size_t self, std::function<void()> &task) {
+    {
+        auto &own = *m_queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < m_queues.size(); ++i) {
+        auto &victim = *m_queues[(self + i) % m_queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::worker(size_t self) {
+    t_pool = this;
+    t_self = self;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(m_lock);
+            m_work_cv.wait(guard, [this] { return m_stop || m_queued > 0; });
+            if (m_queued == 0)
+                return;
+            --m_queued;
+        }
+
+        // a task is reserved for us, but another worker may pop it from
+        // the deque first; keep looking until we find one
+        std::function<void()> task;
+        while (!pop_task(self, task))
+            std::this_thread::yield();
+        task();
+
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (--m_pending == 0)
+            m_done_cv.notify_all();
+    }
+}
@@ -0,0 +1,84 @@
+// MIT License
+
+// Copyright (c) 2018 finixbit
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef H_THREAD_POOL
+#define H_THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace elf_parser {
+
+/* Work-stealing thread pool. Each worker owns a deque: it pops its own work
+ * from the back and, when empty, steals from the front of the others. Tasks
+ * submitted from a worker land in that worker's deque; tasks submitted from
+ * outside are spread round-robin. */
+class ThreadPool {
+    public:
+        explicit ThreadPool(size_t nthreads = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        void submit(std::function<void()> task);
+
+        /* block until every submitted task has finished */
+        void wait();
+
+        /* run fn(0) .. fn(n - 1) across the pool and return when all are
+         * done. The caller works on the range too, so this is safe to call
+         * from inside a pool task. If fn throws, the indices not yet started
+         * are skipped and the first exception is rethrown here, after every
+         * running call has returned. */
+        void parallel_for(size_t n, const std::function<void(size_t)> &fn);
+
+        size_t size() const { return m_threads.size(); }
+
+    private:
+        typedef struct {
+            std::mutex lock;
+            std::deque<std::function<void()>> tasks;
+        } queue_t;
+
+        void worker(size_t self);
+        bool pop_task(size_t self, std::function<void()> &task);
+
+        std::vector<std::unique_ptr<queue_t>> m_queues;
+        std::vector<std::thread> m_threads;
+
+        std::mutex m_lock;
+        std::condition_variable m_work_cv, m_done_cv;
+        size_t m_queued = 0, m_pending = 0;
+        std::atomic<size_t> m_next{0};
+        bool m_stop = false;
+};
+
+}
+#endif